@@ -0,0 +1,448 @@
+#include "athletetable.h"
+
+#include <QRegularExpression>
+#include <QSet>
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Text for the four states of each packed field, indexed by the field's bits.
+// No medal reads NA, as in the source data.
+const QString MedalNames[] = {QStringLiteral("NA"), QStringLiteral("Gold"), QStringLiteral("Silver"), QStringLiteral("Bronze")};
+const QString SeasonNames[] = {QString(), QStringLiteral("Summer"), QStringLiteral("Winter"), QString()};
+const QString SexNames[] = {QString(), QStringLiteral("M"), QStringLiteral("F"), QString()};
+
+const QString* flagNames(AthleteTable::Flag mask) {
+    switch (mask) {
+    case AthleteTable::SeasonMask: return SeasonNames;
+    case AthleteTable::SexMask: return SexNames;
+    default: return MedalNames;
+    }
+}
+
+// Position of each value in case-insensitive order; values that only differ in case share one
+QVector<quint32> valueRanks(const QVector<QString>& values) {
+    QVector<int> order(values.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&values](int left, int right) {
+        return values.at(left).compare(values.at(right), Qt::CaseInsensitive) < 0;
+    });
+
+    QVector<quint32> ranks(values.size());
+    quint32 rank = 0;
+    for (int i = 0; i < order.size(); ++i) {
+        if (i > 0 && values.at(order.at(i - 1)).compare(values.at(order.at(i)), Qt::CaseInsensitive) != 0) {
+            ++rank;
+        }
+        ranks[order.at(i)] = rank;
+    }
+    return ranks;
+}
+
+// Ranks the states of a packed field together with the texts of its third state
+QVector<quint32> flagKeys(const QVector<quint8>& flags, AthleteTable::Flag mask, const QHash<int, QString>& others) {
+    const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+    QVector<QString> values;
+    for (int state = 0; state < 4; ++state) {
+        values.append(AthleteTable::flagText(static_cast<quint8>(state << shift), mask));
+    }
+    QHash<int, int> positions;
+    for (auto it = others.constBegin(); it != others.constEnd(); ++it) {
+        positions.insert(it.key(), values.size());
+        values.append(it.value());
+    }
+    const QVector<quint32> ranks = valueRanks(values);
+
+    QVector<quint32> keys;
+    keys.reserve(flags.size());
+    for (int index = 0; index < flags.size(); ++index) {
+        const int state = (flags.at(index) & mask) >> shift;
+        keys.append(ranks.at(state == 3 ? positions.value(index, state) : state));
+    }
+    return keys;
+}
+
+// Flips the sign bit so negative numbers order before positive ones
+quint32 signedKey(int value) {
+    return static_cast<quint32>(value) ^ 0x80000000u;
+}
+
+template <typename Column>
+QVector<quint32> measurementKeys(const Column& column) {
+    const quint32 missing = quint32(std::numeric_limits<quint16>::max()) + 1;
+    QVector<quint32> keys;
+    keys.reserve(column.size());
+    for (int row = 0; row < column.size(); ++row) {
+        keys.append(column.isNull(row) ? missing : column.rawValues().at(row));
+    }
+    return keys;
+}
+
+QVector<quint32> dictionaryKeys(const DictionaryColumn& column) {
+    const QVector<quint32> ranks = valueRanks(column.dictionary().values());
+    QVector<quint32> keys;
+    keys.reserve(column.size());
+    for (quint32 code : column.codes()) {
+        keys.append(ranks.at(code));
+    }
+    return keys;
+}
+
+}
+
+void DictionaryColumn::assign(const QVector<QString>& dictionary, const QVector<quint32>& codes) {
+    values.clear();
+    QVector<quint32> remap;
+    remap.reserve(dictionary.size());
+    bool distinct = true;
+    for (const QString& value : dictionary) {
+        remap.append(values.insert(value));
+        distinct = distinct && remap.last() == static_cast<quint32>(remap.size() - 1);
+    }
+
+    // Stored dictionaries hold distinct values, so the codes carry over as they are
+    rowCodes = codes;
+    if (!distinct) {
+        for (quint32& code : rowCodes) {
+            code = remap.at(static_cast<int>(code));
+        }
+    }
+}
+
+quint32 AthleteDimension::intern(const Athlete& athlete) {
+    if (athlete.id != 0) {
+        auto it = indexById.constFind(athlete.id);
+        if (it != indexById.constEnd()) {
+            return it.value();
+        }
+    }
+
+    const quint32 index = static_cast<quint32>(idColumn.size());
+    idColumn.append(athlete.id);
+    if (athlete.nameSpan.source != 0) {
+        nameColumn.append(athlete.nameSpan);
+    } else {
+        nameColumn.append(athlete.name);
+    }
+    const quint8 sex = AthleteTable::flagValue(athlete.sex, AthleteTable::SexMask);
+    sexColumn.append(sex);
+    if (sex == AthleteTable::OtherSex) {
+        otherSexTexts.insert(static_cast<int>(index), athlete.sex);
+    }
+    if (athlete.id != 0) {
+        indexById.insert(athlete.id, index);
+    }
+    return index;
+}
+
+const QString& AthleteDimension::sex(int index) const {
+    return AthleteTable::flagText(sexColumn.at(index), AthleteTable::SexMask, otherSexTexts, index);
+}
+
+void AthleteDimension::assign(const QVector<int>& ids, const QVector<QByteArray>& names,
+                              const QVector<quint8>& sexes, const QHash<int, QString>& otherSexes) {
+    idColumn = ids;
+    nameColumn = TextColumn();
+    nameColumn.reserve(names.size());
+    for (const QByteArray& name : names) {
+        nameColumn.append(name);
+    }
+    sexColumn = sexes;
+    otherSexTexts = otherSexes;
+    indexById.clear();
+    indexById.reserve(ids.size());
+    for (int index = 0; index < ids.size(); ++index) {
+        if (ids.at(index) != 0) {
+            indexById.insert(ids.at(index), static_cast<quint32>(index));
+        }
+    }
+}
+
+void AthleteTable::reserve(int rows) {
+    athleteColumn.reserve(rows);
+    ageColumn.reserve(rows);
+    heightColumn.reserve(rows);
+    weightColumn.reserve(rows);
+    teamColumn.reserve(rows);
+    nocColumn.reserve(rows);
+    gamesColumn.reserve(rows);
+    yearColumn.reserve(rows);
+    cityColumn.reserve(rows);
+    sportColumn.reserve(rows);
+    eventColumn.reserve(rows);
+    flagColumn.reserve(rows);
+    countryColumn.reserve(rows);
+}
+
+void AthleteTable::clear() {
+    *this = AthleteTable();
+}
+
+void AthleteTable::append(const Athlete& athlete) {
+    athleteColumn.append(athleteDimension.intern(athlete));
+    ageColumn.append(athlete.age);
+    heightColumn.append(athlete.height);
+    weightColumn.append(athlete.weight);
+    const quint32 team = teamColumn.append(athlete.team);
+    if (team < static_cast<quint32>(teamCountries.size())) {
+        countryColumn.appendCode(teamCountries.at(team));
+    } else {
+        teamCountries.append(countryColumn.append(countryName(athlete.team)));
+    }
+    nocColumn.append(athlete.noc);
+    gamesColumn.append(athlete.games);
+    yearColumn.append(athlete.year);
+    cityColumn.append(athlete.city);
+    sportColumn.append(athlete.sport);
+    eventColumn.append(athlete.event);
+    const quint8 season = flagValue(athlete.season, SeasonMask);
+    if (season == OtherSeason) {
+        otherSeasonTexts.insert(flagColumn.size(), athlete.season);
+    }
+    flagColumn.append(flagValue(athlete.medal, MedalMask) | season);
+}
+
+void AthleteTable::append(const QVector<Athlete>& rows) {
+    // Grow geometrically so a load committed in many batches does not copy the columns each time
+    const int needed = size() + rows.size();
+    if (athleteColumn.capacity() < needed) {
+        reserve(qMax(needed, size() * 2));
+    }
+    for (const Athlete& athlete : rows) {
+        append(athlete);
+    }
+}
+
+bool AthleteTable::assign(const StoredColumns& columns) {
+    const int rows = columns.nameCodes.size();
+    const StoredDictionary* dictionaries[] = {
+        &columns.sexes, &columns.teams, &columns.nocs, &columns.games, &columns.seasons,
+        &columns.cities, &columns.sports, &columns.events, &columns.medals
+    };
+    bool valid = columns.ids.size() == rows && columns.years.size() == rows && columns.ages.size() == rows
+                 && columns.heights.size() == rows && columns.weights.size() == rows;
+    for (const StoredDictionary* dictionary : dictionaries) {
+        valid = valid && dictionary->codes.size() == rows;
+        for (int row = 0; valid && row < rows; ++row) {
+            valid = dictionary->codes.at(row) < static_cast<quint32>(dictionary->values.size());
+        }
+    }
+    for (int row = 0; valid && row < rows; ++row) {
+        valid = columns.nameCodes.at(row) < static_cast<quint32>(columns.names.size());
+    }
+    if (!valid) {
+        return false;
+    }
+
+    // Packed fields are worked out once per distinct value, not per row
+    auto flagValues = [](const StoredDictionary& dictionary, Flag mask) {
+        QVector<quint8> bits;
+        bits.reserve(dictionary.values.size());
+        for (const QString& value : dictionary.values) {
+            bits.append(flagValue(value, mask));
+        }
+        return bits;
+    };
+    const QVector<quint8> sexBits = flagValues(columns.sexes, SexMask);
+    const QVector<quint8> seasonBits = flagValues(columns.seasons, SeasonMask);
+    const QVector<quint8> medalBits = flagValues(columns.medals, MedalMask);
+
+    // Athlete attributes are repeated on every row; the first row of each athlete supplies them
+    const int athleteCount = columns.names.size();
+    QVector<int> ids(athleteCount, 0);
+    QVector<quint8> sexes(athleteCount, 0);
+    QVector<char> seen(athleteCount, 0);
+    QHash<int, QString> otherSexes;
+    for (int row = 0; row < rows; ++row) {
+        const int index = static_cast<int>(columns.nameCodes.at(row));
+        if (seen.at(index)) {
+            continue;
+        }
+        seen[index] = 1;
+        ids[index] = columns.ids.at(row);
+        const quint32 sex = columns.sexes.codes.at(row);
+        sexes[index] = sexBits.at(static_cast<int>(sex));
+        if (sexes.at(index) == OtherSex) {
+            otherSexes.insert(index, columns.sexes.values.at(static_cast<int>(sex)));
+        }
+    }
+
+    AthleteTable table;
+    table.reserve(rows);
+    table.athleteDimension.assign(ids, columns.names, sexes, otherSexes);
+    table.athleteColumn = columns.nameCodes;
+    table.teamColumn.assign(columns.teams.values, columns.teams.codes);
+    table.nocColumn.assign(columns.nocs.values, columns.nocs.codes);
+    table.gamesColumn.assign(columns.games.values, columns.games.codes);
+    table.cityColumn.assign(columns.cities.values, columns.cities.codes);
+    table.sportColumn.assign(columns.sports.values, columns.sports.codes);
+    table.eventColumn.assign(columns.events.values, columns.events.codes);
+    table.yearColumn = columns.years;
+
+    for (int row = 0; row < rows; ++row) {
+        table.ageColumn.append(columns.ages.at(row));
+        table.heightColumn.append(columns.heights.at(row));
+        table.weightColumn.append(columns.weights.at(row));
+
+        const quint32 season = columns.seasons.codes.at(row);
+        const quint8 seasonFlag = seasonBits.at(static_cast<int>(season));
+        if (seasonFlag == OtherSeason) {
+            table.otherSeasonTexts.insert(row, columns.seasons.values.at(static_cast<int>(season)));
+        }
+        table.flagColumn.append(medalBits.at(static_cast<int>(columns.medals.codes.at(row))) | seasonFlag);
+    }
+
+    // Countries follow from the team dictionary, one per distinct team
+    const StringDictionary& teams = table.teamColumn.dictionary();
+    StringDictionary countries;
+    table.teamCountries.reserve(teams.size());
+    for (const QString& team : teams.values()) {
+        table.teamCountries.append(countries.insert(countryName(team)));
+    }
+    QVector<quint32> countryCodes;
+    countryCodes.reserve(rows);
+    for (quint32 team : table.teamColumn.codes()) {
+        countryCodes.append(table.teamCountries.at(static_cast<int>(team)));
+    }
+    table.countryColumn.assign(countries.values(), countryCodes);
+
+    *this = table;
+    return true;
+}
+
+Athlete AthleteTable::athlete(int row) const {
+    Athlete athlete;
+    const quint32 index = athleteColumn.at(row);
+    athlete.id = athleteDimension.ids().at(index);
+    athlete.name = athleteDimension.names().utf8(index);
+    athlete.sex = athleteDimension.sex(index);
+    athlete.age = ageColumn.at(row);
+    athlete.height = heightColumn.at(row);
+    athlete.weight = weightColumn.at(row);
+    athlete.team = teamColumn.at(row);
+    athlete.noc = nocColumn.at(row);
+    athlete.games = gamesColumn.at(row);
+    athlete.year = yearColumn.at(row);
+    athlete.season = season(row);
+    athlete.city = cityColumn.at(row);
+    athlete.sport = sportColumn.at(row);
+    athlete.event = eventColumn.at(row);
+    athlete.medal = flagText(flagColumn.at(row), MedalMask);
+    return athlete;
+}
+
+QVector<quint32> AthleteTable::sortKeys(Field field) const {
+    switch (field) {
+    case AgeField: return measurementKeys(ageColumn);
+    case HeightField: return measurementKeys(heightColumn);
+    case WeightField: return measurementKeys(weightColumn);
+    case TeamField: return dictionaryKeys(teamColumn);
+    case NocField: return dictionaryKeys(nocColumn);
+    case GamesField: return dictionaryKeys(gamesColumn);
+    case CityField: return dictionaryKeys(cityColumn);
+    case SportField: return dictionaryKeys(sportColumn);
+    case EventField: return dictionaryKeys(eventColumn);
+    default: break;
+    }
+
+    QVector<quint32> keys;
+    keys.reserve(size());
+    if (field == YearField) {
+        for (int year : yearColumn) {
+            keys.append(signedKey(year));
+        }
+    } else if (field == SeasonField) {
+        keys = flagKeys(flagColumn, SeasonMask, otherSeasonTexts);
+    } else if (field == MedalField) {
+        keys = flagKeys(flagColumn, MedalMask, QHash<int, QString>());
+    } else {
+        // Athlete fields are ranked once per athlete and spread over their rows
+        const int athleteCount = athleteDimension.size();
+        QVector<quint32> athleteKeys;
+        athleteKeys.reserve(athleteCount);
+        if (field == IdField) {
+            for (int id : athleteDimension.ids()) {
+                athleteKeys.append(signedKey(id));
+            }
+        } else if (field == NameField) {
+            QVector<QString> names;
+            names.reserve(athleteCount);
+            for (int index = 0; index < athleteCount; ++index) {
+                // Decoded directly, since every name passing through the cache would only evict the rest
+                names.append(QString::fromUtf8(athleteDimension.names().utf8(index)));
+            }
+            athleteKeys = valueRanks(names);
+        } else {
+            athleteKeys = flagKeys(athleteDimension.sexes(), SexMask, athleteDimension.otherSexes());
+        }
+        for (quint32 index : athleteColumn) {
+            keys.append(athleteKeys.at(index));
+        }
+    }
+    return keys;
+}
+
+QVector<AthleteTable::Career> AthleteTable::careers() const {
+    QVector<Career> totals(athleteDimension.size());
+    QSet<quint64> athleteGames;  // (athlete, Games code) pairs already counted
+
+    for (int row = 0; row < size(); ++row) {
+        const quint32 index = athleteColumn.at(row);
+        Career& career = totals[index];
+        ++career.entries;
+
+        switch (flagColumn.at(row) & MedalMask) {
+        case GoldMedal: ++career.gold; break;
+        case SilverMedal: ++career.silver; break;
+        case BronzeMedal: ++career.bronze; break;
+        default: break;
+        }
+
+        const quint64 key = (quint64(index) << 32) | gamesColumn.code(row);
+        if (!athleteGames.contains(key)) {
+            athleteGames.insert(key);
+            ++career.games;
+        }
+    }
+    return totals;
+}
+
+QString AthleteTable::countryName(const QString& team) {
+    static const QRegularExpression pattern("-(\\d+)$");
+
+    QString country = team;
+    const QRegularExpressionMatch match = pattern.match(country);
+    if (match.hasMatch()) {
+        country.truncate(match.capturedStart());
+    }
+    return country;
+}
+
+quint8 AthleteTable::flagValue(const QString& text, Flag mask) {
+    const QString* names = flagNames(mask);
+    const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+    for (int state = 1; state < 4; ++state) {
+        if (!names[state].isEmpty() && names[state].compare(text, Qt::CaseInsensitive) == 0) {
+            return static_cast<quint8>(state << shift);
+        }
+    }
+    // Medals outside the three mean no medal, which reads NA
+    return mask == MedalMask || text.isEmpty() ? 0 : mask;
+}
+
+const QString& AthleteTable::flagText(quint8 flags, Flag mask) {
+    const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+    return flagNames(mask)[(flags & mask) >> shift];
+}
+
+const QString& AthleteTable::flagText(quint8 flags, Flag mask, const QHash<int, QString>& others, int index) {
+    if (mask != MedalMask && (flags & mask) == mask) {
+        auto it = others.constFind(index);
+        if (it != others.constEnd()) {
+            return it.value();
+        }
+    }
+    return flagText(flags, mask);
+}
@@ -0,0 +1,334 @@
+#ifndef ATHLETETABLE_H
+#define ATHLETETABLE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include <cmath>
+#include <limits>
+
+#include "stringdictionary.h"
+#include "textcolumn.h"
+
+// One parsed CSV record. Loaders produce these; DataBase stores them column-wise.
+struct Athlete {
+    int id;
+    QByteArray name;    // UTF-8; empty when nameSpan points into a mapped source
+    TextSpan nameSpan;
+    QString sex;
+    float age;
+    float height;
+    float weight;
+    QString team;
+    QString noc;
+    QString games;
+    int year;
+    QString season;
+    QString city;
+    QString sport;
+    QString event;
+    QString medal;
+
+    // Age, height and weight are NaN when the source says NA
+    static float missingValue() { return std::numeric_limits<float>::quiet_NaN(); }
+    static bool isMissing(float value) { return std::isnan(value); }
+};
+
+// A categorical column: one code per row plus the column's shared dictionary.
+class DictionaryColumn {
+public:
+    int size() const { return rowCodes.size(); }
+    void reserve(int rows) { rowCodes.reserve(rows); }
+    quint32 append(const QString& value) {
+        const quint32 code = values.insert(value);
+        rowCodes.append(code);
+        return code;
+    }
+    // Repeats a value already in the dictionary without hashing it again.
+    void appendCode(quint32 code) { rowCodes.append(code); }
+    // Replaces the column with codes into values, which must all be in range.
+    void assign(const QVector<QString>& values, const QVector<quint32>& codes);
+
+    const QString& at(int row) const { return values.value(rowCodes.at(row)); }
+    quint32 code(int row) const { return rowCodes.at(row); }
+
+    const QVector<quint32>& codes() const { return rowCodes; }
+    const StringDictionary& dictionary() const { return values; }
+
+private:
+    StringDictionary values;
+    QVector<quint32> rowCodes;
+};
+
+// Fixed-point measurement column: Scale steps per unit in a small unsigned
+// integer, plus a validity bitmap so a null is distinct from zero. Values
+// outside the representable range are clamped.
+template <typename Storage, int Scale>
+class MeasurementColumn {
+public:
+    int size() const { return values.size(); }
+    void reserve(int rows) {
+        values.reserve(rows);
+        validRows.reserve((rows + 63) / 64);
+    }
+    void append(float value);
+
+    bool isNull(int row) const { return (validRows.at(row >> 6) & (quint64(1) << (row & 63))) == 0; }
+    float at(int row) const {
+        return isNull(row) ? Athlete::missingValue() : values.at(row) / static_cast<float>(Scale);
+    }
+
+    const QVector<Storage>& rawValues() const { return values; }
+    const QVector<quint64>& validity() const { return validRows; }
+
+private:
+    QVector<Storage> values;
+    QVector<quint64> validRows;
+};
+
+template <typename Storage, int Scale>
+void MeasurementColumn<Storage, Scale>::append(float value) {
+    const int row = values.size();
+    if (row % 64 == 0) {
+        validRows.append(0);
+    }
+    if (Athlete::isMissing(value)) {
+        values.append(0);
+        return;
+    }
+    validRows.last() |= quint64(1) << (row % 64);
+    const float maximum = std::numeric_limits<Storage>::max();
+    values.append(static_cast<Storage>(qBound(0.0f, std::round(value * Scale), maximum)));
+}
+
+typedef MeasurementColumn<quint8, 1> AgeColumn;      // whole years
+typedef MeasurementColumn<quint16, 10> TenthsColumn; // centimetres and kilograms to 0.1
+
+// The athletes dimension: one entry per distinct athlete ID holding what does
+// not change from event to event. The first record seen for an ID supplies
+// its name and sex; records without an ID each get an entry of their own.
+class AthleteDimension {
+public:
+    int size() const { return idColumn.size(); }
+
+    // Returns the entry for the record's athlete, adding it on first sight.
+    quint32 intern(const Athlete& athlete);
+
+    const QVector<int>& ids() const { return idColumn; }
+    const TextColumn& names() const { return nameColumn; }
+    const QVector<quint8>& sexes() const { return sexColumn; }  // AthleteTable::SexMask bits
+    // Sex values other than M and F, by entry; their bits are AthleteTable::OtherSex.
+    const QHash<int, QString>& otherSexes() const { return otherSexTexts; }
+    const QString& sex(int index) const;
+
+    // Replaces every entry with the given ones, indexed alike; sexes holds
+    // AthleteTable::SexMask bits.
+    void assign(const QVector<int>& ids, const QVector<QByteArray>& names, const QVector<quint8>& sexes,
+                const QHash<int, QString>& otherSexes);
+
+    // Takes names out of mapped source files; see TextColumn::detach().
+    void detachText() { nameColumn.detach(); }
+
+private:
+    QVector<int> idColumn;
+    TextColumn nameColumn;
+    QVector<quint8> sexColumn;
+    QHash<int, QString> otherSexTexts;
+    QHash<int, quint32> indexById;
+};
+
+// Column-oriented athlete storage: one contiguous array per field, so a scan
+// over a single attribute only reads that attribute. Categorical fields are
+// dictionary-encoded, medal, season and sex are bit-packed and measurements
+// are fixed-point, so filters and group-bys work on small integers. Each row
+// is one athlete-event entry that refers to its athlete in athletes(). Copies
+// share the columns.
+class AthleteTable {
+public:
+    int size() const { return athleteColumn.size(); }
+    bool isEmpty() const { return athleteColumn.isEmpty(); }
+
+    void reserve(int rows);
+    void clear();
+    void append(const Athlete& athlete);
+    void append(const QVector<Athlete>& rows);
+
+    bool hasMappedText() const { return athleteDimension.names().isMapped(); }
+    void detachText() { athleteDimension.detachText(); }
+
+    // Materializes a full row; prefer the columns or AthleteRow in loops.
+    Athlete athlete(int row) const;
+
+    // A text column as stored outside the table: its distinct values and one
+    // code into them per row.
+    struct StoredDictionary {
+        QVector<QString> values;
+        QVector<quint32> codes;
+    };
+
+    // Every column with one value per row, as DataSnapshot keeps them. Names
+    // are one per athlete and nameCodes gives each row's athlete.
+    struct StoredColumns {
+        QVector<int> ids;
+        QVector<int> years;
+        QVector<float> ages;
+        QVector<float> heights;
+        QVector<float> weights;
+        QVector<QByteArray> names;
+        QVector<quint32> nameCodes;
+        StoredDictionary sexes;
+        StoredDictionary teams;
+        StoredDictionary nocs;
+        StoredDictionary games;
+        StoredDictionary seasons;
+        StoredDictionary cities;
+        StoredDictionary sports;
+        StoredDictionary events;
+        StoredDictionary medals;
+    };
+
+    // Replaces the rows with stored columns, taking over their dictionaries and
+    // codes instead of interning every value again. Fails, leaving the table
+    // unchanged, when the columns differ in length or a code is out of range.
+    bool assign(const StoredColumns& columns);
+
+    // Fields in CSV order, which is also the order of the table view's columns.
+    enum Field {
+        IdField,
+        NameField,
+        SexField,
+        AgeField,
+        HeightField,
+        WeightField,
+        TeamField,
+        NocField,
+        GamesField,
+        YearField,
+        SeasonField,
+        CityField,
+        SportField,
+        EventField,
+        MedalField,
+        FieldCount
+    };
+
+    // One key per row that orders like the field's displayed values: numbers
+    // by value with missing measurements last, text case-insensitively.
+    QVector<quint32> sortKeys(Field field) const;
+
+    // Medal and season share one byte per row and sex one byte per athlete,
+    // two bits each. Zero in a field means no medal (NA) or an empty value. Any
+    // other season or sex takes the third state, and its text is kept aside
+    // in otherSeasons() or AthleteDimension::otherSexes().
+    enum Flag : quint8 {
+        MedalMask = 0x03,
+        GoldMedal = 0x01,
+        SilverMedal = 0x02,
+        BronzeMedal = 0x03,
+        SeasonMask = 0x0c,
+        SummerSeason = 0x04,
+        WinterSeason = 0x08,
+        OtherSeason = 0x0c,
+        SexMask = 0x30,
+        MaleSex = 0x10,
+        FemaleSex = 0x20,
+        OtherSex = 0x30
+    };
+
+    // Converts between the text of one packed field (selected by its mask) and
+    // its bits. Known values match case-insensitively; the third state of
+    // season and sex has no text of its own.
+    static quint8 flagValue(const QString& text, Flag mask);
+    static const QString& flagText(quint8 flags, Flag mask);
+    // As above, with the third state read from others at index.
+    static const QString& flagText(quint8 flags, Flag mask, const QHash<int, QString>& others, int index);
+
+    const AthleteDimension& athletes() const { return athleteDimension; }
+    // Index into athletes() per row.
+    const QVector<quint32>& athleteIndexes() const { return athleteColumn; }
+
+    const AgeColumn& ages() const { return ageColumn; }
+    const TenthsColumn& heights() const { return heightColumn; }
+    const TenthsColumn& weights() const { return weightColumn; }
+    const DictionaryColumn& teams() const { return teamColumn; }
+    const DictionaryColumn& nocs() const { return nocColumn; }
+    const DictionaryColumn& games() const { return gamesColumn; }
+    const QVector<int>& years() const { return yearColumn; }
+    const DictionaryColumn& cities() const { return cityColumn; }
+    const DictionaryColumn& sports() const { return sportColumn; }
+    const DictionaryColumn& events() const { return eventColumn; }
+    const QVector<quint8>& flags() const { return flagColumn; }
+    // Season values other than Summer and Winter, by row.
+    const QHash<int, QString>& otherSeasons() const { return otherSeasonTexts; }
+    const QString& season(int row) const { return flagText(flagColumn.at(row), SeasonMask, otherSeasonTexts, row); }
+
+    // Team with the numeric suffix of secondary entries removed ("Brazil-2"
+    // becomes "Brazil"). Derived once per distinct team while appending.
+    const DictionaryColumn& countries() const { return countryColumn; }
+
+    static QString countryName(const QString& team);
+
+    struct Career {
+        int entries = 0;
+        int gold = 0;
+        int silver = 0;
+        int bronze = 0;
+        int games = 0;
+
+        int medals() const { return gold + silver + bronze; }
+    };
+
+    // Per-athlete totals over all rows, indexed like athletes(), in one pass.
+    QVector<Career> careers() const;
+
+private:
+    AthleteDimension athleteDimension;
+    QVector<quint32> athleteColumn;
+    AgeColumn ageColumn;
+    TenthsColumn heightColumn;
+    TenthsColumn weightColumn;
+    DictionaryColumn teamColumn;
+    DictionaryColumn nocColumn;
+    DictionaryColumn gamesColumn;
+    QVector<int> yearColumn;
+    DictionaryColumn cityColumn;
+    DictionaryColumn sportColumn;
+    DictionaryColumn eventColumn;
+    QVector<quint8> flagColumn;
+    QHash<int, QString> otherSeasonTexts;
+    DictionaryColumn countryColumn;
+    QVector<quint32> teamCountries;  // country code per team code
+};
+
+// Read-only view of one row that fetches each field from its column on demand.
+class AthleteRow {
+public:
+    AthleteRow(const AthleteTable& table, int row) : table(&table), row(row) {}
+
+    quint32 athlete() const { return table->athleteIndexes().at(row); }
+    int id() const { return table->athletes().ids().at(athlete()); }
+    QString name() const { return table->athletes().names().toString(athlete()); }
+    const QString& sex() const { return table->athletes().sex(athlete()); }
+    float age() const { return table->ages().at(row); }
+    float height() const { return table->heights().at(row); }
+    float weight() const { return table->weights().at(row); }
+    const QString& team() const { return table->teams().at(row); }
+    const QString& noc() const { return table->nocs().at(row); }
+    const QString& games() const { return table->games().at(row); }
+    int year() const { return table->years().at(row); }
+    const QString& season() const { return table->season(row); }
+    const QString& city() const { return table->cities().at(row); }
+    const QString& sport() const { return table->sports().at(row); }
+    const QString& event() const { return table->events().at(row); }
+    const QString& medal() const { return AthleteTable::flagText(table->flags().at(row), AthleteTable::MedalMask); }
+    const QString& country() const { return table->countries().at(row); }
+
+private:
+    const AthleteTable* table;
+    int row;
+};
+
+#endif // ATHLETETABLE_H
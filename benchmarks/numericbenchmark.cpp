@@ -0,0 +1,129 @@
+// Per-field cost of decoding the numeric columns (ID, Age, Height, Weight,
+// Year): the old conversion through QString against CsvParser's byte-span
+// decoders, over the same generated fields. Built with -DOLYMPIC_BUILD_BENCHMARKS=ON.
+
+#include "csvparser.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QString>
+#include <QVector>
+
+#include <cstdio>
+
+namespace {
+const int FieldsPerColumn = 1000000;
+const int Rounds = 5;
+
+enum Kind {
+    IntegerField,
+    MeasurementField
+};
+
+struct Column {
+    const char* name;
+    Kind kind;
+    QByteArray text;
+    QVector<CsvField> fields;
+};
+
+// Values shaped like the dataset's: whole IDs and years, ages, and heights
+// and weights that sometimes carry one decimal. About one in ten measurements is NA.
+QByteArray generateValue(Kind kind, int column, QRandomGenerator& random) {
+    if (kind == IntegerField) {
+        return QByteArray::number(column == 0 ? random.bounded(1, 135572) : random.bounded(1896, 2017));
+    }
+    if (random.bounded(10) == 0) {
+        return QByteArrayLiteral("NA");
+    }
+    const int whole = random.bounded(10, 215);
+    if (column == 1 || random.bounded(3) != 0) {
+        return QByteArray::number(whole);
+    }
+    return QByteArray::number(whole) + '.' + QByteArray::number(random.bounded(10));
+}
+
+void fill(Column& column, int index, QRandomGenerator& random) {
+    QVector<int> ends;
+    ends.reserve(FieldsPerColumn);
+    for (int i = 0; i < FieldsPerColumn; ++i) {
+        column.text += generateValue(column.kind, index, random);
+        ends.append(column.text.size());
+    }
+    // The text stops growing before the spans are taken
+    const char* data = column.text.constData();
+    int begin = 0;
+    for (int end : ends) {
+        column.fields.append(CsvField{data + begin, data + end, false});
+        begin = end;
+    }
+}
+
+// What the parser did per field before decoding from the bytes
+double oldValue(const CsvField& field, Kind kind) {
+    const QString text = QString::fromUtf8(field.begin, field.size());
+    if (kind == IntegerField) {
+        return text.toInt();
+    }
+    return text == "NA" ? 0.0f : text.toFloat();
+}
+
+double newValue(const CsvField& field, Kind kind) {
+    if (kind == IntegerField) {
+        return CsvParser::toInteger(field);
+    }
+    const float value = CsvParser::toMeasurement(field);
+    return Athlete::isMissing(value) ? 0.0f : value;
+}
+
+// Best of several rounds, in nanoseconds per field. The sum keeps the work from being optimized away.
+template <typename Decode>
+double timePerField(const Column& column, Decode decode, double& sum) {
+    qint64 best = -1;
+    for (int round = 0; round < Rounds; ++round) {
+        QElapsedTimer timer;
+        timer.start();
+        for (const CsvField& field : column.fields) {
+            sum += decode(field, column.kind);
+        }
+        const qint64 elapsed = timer.nsecsElapsed();
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return static_cast<double>(best) / column.fields.size();
+}
+}
+
+int main() {
+    QRandomGenerator random(2016);
+    Column columns[] = {
+        {"ID", IntegerField, QByteArray(), QVector<CsvField>()},
+        {"Age", MeasurementField, QByteArray(), QVector<CsvField>()},
+        {"Height", MeasurementField, QByteArray(), QVector<CsvField>()},
+        {"Weight", MeasurementField, QByteArray(), QVector<CsvField>()},
+        {"Year", IntegerField, QByteArray(), QVector<CsvField>()}
+    };
+
+    int mismatches = 0;
+    for (int i = 0; i < 5; ++i) {
+        fill(columns[i], i, random);
+        for (const CsvField& field : columns[i].fields) {
+            if (oldValue(field, columns[i].kind) != newValue(field, columns[i].kind)) {
+                ++mismatches;
+            }
+        }
+    }
+
+    std::printf("%-8s %12s %12s %8s\n", "Column", "QString ns", "bytes ns", "speedup");
+    double sum = 0;
+    for (const Column& column : columns) {
+        const double before = timePerField(column, oldValue, sum);
+        const double after = timePerField(column, newValue, sum);
+        std::printf("%-8s %12.1f %12.1f %7.1fx\n", column.name, before, after, before / after);
+    }
+    std::printf("%d fields per column, %d mismatches (checksum %.0f)\n", FieldsPerColumn, mismatches, sum);
+
+    return mismatches == 0 ? 0 : 1;
+}
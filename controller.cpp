@@ -1,91 +1,306 @@
 #include "controller.h"
 
-#include <QApplication>
-#include <QFile>
-#include <QTextStream>
-#include <QStringList>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSettings>
+#include <QThread>
 
 Controller::Controller(QObject *parent)
-    : QObject(parent), db(DataBase::getInstance())
+    : QObject(parent), db(DataBase::getInstance()), mode(MappedLoad), loadGeneration(0), batchesCommitted(false),
+      currentKind(FullLoad), loadedKind(FullLoad)
 {
+    QSettings settings("OlympicBrowser", "Controller");
+    threadCount = settings.value("ParserThreads", 0).toInt();
+    snapshotsEnabled = settings.value("UseSnapshots", true).toBool();
+    lazyTextMegabytes = settings.value("LazyTextMegabytes", 0).toInt();
+    autoReload = settings.value("AutoReload", false).toBool();
+
+    loaderPool.setMaxThreadCount(1);
+
+    // Writers usually append in several bursts; wait for them to settle
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(500);
+    connect(&reloadTimer, &QTimer::timeout, this, &Controller::reloadAppended);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &Controller::loadedFileChanged);
+    connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &Controller::partitionDirectoryChanged);
 }
 
-bool Controller::loadCSV(const QString& filePath) {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qDebug() << "Failed to open file:" << filePath;
-        emit dataLoaded(false);
-        return false;
+Controller::~Controller() {
+    cancelLoading();
+    loaderPool.waitForDone();
+}
+
+void Controller::setThreadCount(int count) {
+    threadCount = qMax(0, count);
+
+    QSettings settings("OlympicBrowser", "Controller");
+    settings.setValue("ParserThreads", threadCount);
+}
+
+int Controller::effectiveThreadCount() const {
+    return threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount());
+}
+
+void Controller::setSnapshotsEnabled(bool enabled) {
+    snapshotsEnabled = enabled;
+
+    QSettings settings("OlympicBrowser", "Controller");
+    settings.setValue("UseSnapshots", snapshotsEnabled);
+}
+
+void Controller::setLazyTextThreshold(int megabytes) {
+    lazyTextMegabytes = qMax(0, megabytes);
+
+    QSettings settings("OlympicBrowser", "Controller");
+    settings.setValue("LazyTextMegabytes", lazyTextMegabytes);
+}
+
+void Controller::setAutoReload(bool enabled) {
+    autoReload = enabled;
+    updateWatchedFile();
+
+    QSettings settings("OlympicBrowser", "Controller");
+    settings.setValue("AutoReload", autoReload);
+}
+
+void Controller::updateWatchedFile() {
+    if (!watcher.files().isEmpty()) {
+        watcher.removePaths(watcher.files());
+    }
+    if (!watcher.directories().isEmpty()) {
+        watcher.removePaths(watcher.directories());
     }
+    // Rows reading names from the mapped file need to hear of changes to it even without auto-reload
+    if (loadedPath.isEmpty() || (!autoReload && !db->hasMappedText())) {
+        return;
+    }
+
+    // Files replaced on save drop out of the watcher, so the path is re-added after every load.
+    // Partitioned datasets watch their directory, where new partitions show up.
+    if (loadedKind == PartitionedLoad) {
+        const QFileInfo info(loadedPath);
+        watcher.addPath(info.isDir() ? loadedPath : info.absolutePath());
+    } else {
+        watcher.addPath(loadedPath);
+    }
+}
+
+QStringList Controller::partitionListing(const QString& location) {
+    QStringList listing;
+    for (const QString& path : CsvLoader::partitionFiles(location)) {
+        const QFileInfo info(path);
+        listing << path + '\t' + QString::number(info.size()) + '\t'
+                   + QString::number(info.lastModified().toMSecsSinceEpoch());
+    }
+    return listing;
+}
+
+// The directory also receives the partitions' own snapshots, written after the
+// load has finished; only a change to the partitions themselves reloads.
+void Controller::partitionDirectoryChanged() {
+    if (loadedKind == PartitionedLoad && partitionListing(loadedPath) != loadedPartitions) {
+        reloadTimer.start();
+    }
+}
+
+void Controller::loadCSV(const QString& filePath) {
+    startLoading(filePath, FullLoad);
+}
+
+void Controller::loadPartitioned(const QString& location) {
+    startLoading(location, PartitionedLoad);
+}
+
+void Controller::reloadAppended() {
+    if (loadedPath.isEmpty()) {
+        return;
+    }
+    if (isLoading()) {
+        reloadTimer.start();  // Try again once the running load is done
+        return;
+    }
+    // Partitioned datasets grow by adding files; rescanning reuses the per-partition snapshots
+    if (loadedKind == PartitionedLoad) {
+        loadPartitioned(loadedPath);
+        return;
+    }
+    if (ingested.unterminatedTail || !CsvLoader::isPrefixIntact(loadedPath, ingested)) {
+        loadCSV(loadedPath);
+        return;
+    }
+    startLoading(loadedPath, AppendLoad);
+}
 
+// Rows of the last load may still read their names from its mapped file. They are
+// copied out before that file is parsed again, or dropped when it no longer holds
+// what was loaded, since the old offsets would then point at other bytes. An
+// unterminated last record lies past the checked prefix, so it counts as changed.
+// Returns false when the rows were dropped.
+bool Controller::releaseMappedText(const QString& filePath) {
+    if (filePath != loadedPath || !db->hasMappedText()) {
+        return true;
+    }
+    if (!ingested.unterminatedTail && CsvLoader::isPrefixIntact(filePath, ingested)) {
+        db->detachText();
+        return true;
+    }
     db->clear();
-    QTextStream in(&file);
+    return false;
+}
+
+// Names are released as soon as the file changes rather than after the reload
+// delay, since a writer that truncates it would leave them pointing past its end.
+// Rows that had to be dropped are read again once the writer has settled.
+void Controller::loadedFileChanged() {
+    bool reload = autoReload;
+    const bool newRowsShown = isLoading() && batchesCommitted && currentKind != AppendLoad;
+    if (!newRowsShown && db->hasMappedText()) {
+        if (isLoading() && currentKind == AppendLoad) {
+            cancelLoading();  // Its records would land on rows that may be dropped
+        }
+        reload = !releaseMappedText(loadedPath) || reload;
+        updateWatchedFile();
+    }
+    if (reload) {
+        reloadTimer.start();
+    }
+}
 
-    if (!in.atEnd()) {
-        in.readLine();
+void Controller::startLoading(const QString& filePath, LoadKind kind) {
+    cancelLoading();
+    if (kind != AppendLoad) {
+        releaseMappedText(filePath);
     }
 
-    int lineCount = 0;
-    int totalLines = 271116;
+    std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+    cancelFlag = cancelled;
+    const quint64 generation = ++loadGeneration;
+    batchesCommitted = false;
+    currentKind = kind;
+    const CsvLoader::Prefix prefix = ingested;
+    loadingPartitions = kind == PartitionedLoad ? partitionListing(filePath) : QStringList();
 
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        QVector<QString> fields;
-        QString currentField;
-        bool inQuotes = false;
+    CsvLoader::Options options;
+    options.useMapping = (mode == MappedLoad);
+    options.useSnapshot = snapshotsEnabled;
+    options.threadCount = effectiveThreadCount();
+    options.lazyText = lazyTextMegabytes > 0 && QFileInfo(filePath).size() >= qint64(lazyTextMegabytes) << 20;
 
-        for (int i = 0; i < line.length(); ++i) {
-            QChar currentChar = line[i];
+    emit loadingStarted(filePath);
 
-            if (currentChar == '\"') {
-                inQuotes = !inQuotes;
-            }
-            else if (currentChar == ',' && !inQuotes) {
-                if (currentField.startsWith('\"') && currentField.endsWith('\"')) {
-                    currentField = currentField.mid(1, currentField.length() - 2);
-                }
-                fields.append(currentField.trimmed());
-                currentField.clear();
-            }
-            else {
-                currentField += currentChar;
+    loaderPool.start([this, filePath, options, cancelled, generation, kind, prefix]() {
+        CsvLoader::ProgressCallback progress = [this, cancelled](int percent) {
+            if (!*cancelled) {
+                emit progressUpdated(percent);
             }
-        }
+        };
 
-        if (currentField.startsWith('\"') && currentField.endsWith('\"')) {
-            currentField = currentField.mid(1, currentField.length() - 2);
-        }
-        fields.append(currentField.trimmed());
-
-        if (fields.size() >= 15) {
-            Athlete athlete;
-            athlete.id = fields[0].toInt();
-            athlete.name = fields[1];
-            athlete.sex = fields[2];
-            athlete.age = fields[3] == "NA" ? 0.0f : fields[3].toFloat();
-            athlete.height = fields[4] == "NA" ? 0.0f : fields[4].toFloat();
-            athlete.weight = fields[5] == "NA" ? 0.0f : fields[5].toFloat();
-            athlete.team = fields[6];
-            athlete.noc = fields[7];
-            athlete.games = fields[8];
-            athlete.year = fields[9].toInt();
-            athlete.season = fields[10];
-            athlete.city = fields[11];
-            athlete.sport = fields[12];
-            athlete.event = fields[13];
-            athlete.medal = fields[14] == "NA" ? "" : fields[14];
-
-            db->addAthlete(athlete);
-        }
+        CsvLoader::BatchCallback batchReady = [this, generation](const QVector<Athlete>& batch) {
+            QMetaObject::invokeMethod(this, [this, batch, generation]() {
+                commitBatch(batch, generation);
+            }, Qt::QueuedConnection);
+        };
 
-        lineCount++;
-        if (lineCount % 1000 == 0) {
-            emit progressUpdated((lineCount * 100) / totalLines);
-            QApplication::processEvents();  // Keep UI responsive
+        CsvLoader::Result result;
+        switch (kind) {
+        case FullLoad:
+            result = CsvLoader::load(filePath, options, *cancelled, progress, batchReady);
+            break;
+        case AppendLoad:
+            result = CsvLoader::loadAppended(filePath, prefix, options, *cancelled, progress, batchReady);
+            break;
+        case PartitionedLoad:
+            result = CsvLoader::loadPartitions(CsvLoader::partitionFiles(filePath), options, *cancelled,
+                                               progress, batchReady);
+            break;
         }
+
+        QMetaObject::invokeMethod(this, [this, filePath, result, generation]() {
+            finishLoading(filePath, result, generation);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Controller::cancelLoading() {
+    if (!cancelFlag) {
+        return;
+    }
+
+    *cancelFlag = true;
+    cancelFlag.reset();
+    ++loadGeneration;  // Drops batches and the result of the cancelled load when they arrive
+    db->setStreaming(false);
+    discardCommittedBatches();
+
+    emit loadingCancelled();
+}
+
+// A load that stops after committing batches has replaced the previous dataset
+// with part of a new one. That matches no file, so nothing reloads or watches it.
+void Controller::discardCommittedBatches() {
+    if (!batchesCommitted) {
+        return;
+    }
+    batchesCommitted = false;
+    db->clear();
+    loadedPath.clear();
+    ingested = CsvLoader::Prefix();
+    loadedPartitions.clear();
+    updateWatchedFile();
+}
+
+void Controller::commitBatch(const QVector<Athlete>& batch, quint64 generation) {
+    if (generation != loadGeneration) {
+        return;
+    }
+
+    // The previous dataset stays visible until the new one produces its first rows;
+    // appended records go on top of it as a single insert
+    if (!batchesCommitted && currentKind != AppendLoad) {
+        db->clear();
+        db->setStreaming(true);
+        ingested = CsvLoader::Prefix();
+    }
+    batchesCommitted = true;
+    db->appendBatch(batch);
+}
+
+void Controller::finishLoading(const QString& filePath, const CsvLoader::Result& result, quint64 generation) {
+    if (generation != loadGeneration) {
+        return;
+    }
+    cancelFlag.reset();
+    db->setStreaming(false);
+
+    if (result.prefixChanged) {
+        qDebug() << "File was rewritten rather than appended to, reloading:" << filePath;
+        loadCSV(filePath);
+        return;
+    }
+
+    if (!result.success) {
+        discardCommittedBatches();
+        emit dataLoaded(false);
+        return;
+    }
+
+    if (result.fromSnapshot) {
+        db->setTable(result.table);
+    } else if (!batchesCommitted && currentKind != AppendLoad) {
+        db->clear();
+    }
+
+    loadedPath = filePath;
+    loadedKind = currentKind == AppendLoad ? FullLoad : currentKind;
+    ingested = result.prefix;
+    loadedPartitions = loadingPartitions;
+    updateWatchedFile();
+
+    // Partitions write their own snapshots while loading
+    if (snapshotsEnabled && !result.fromSnapshot && currentKind != PartitionedLoad
+        && (currentKind != AppendLoad || result.rows > 0)) {
+        db->saveSnapshot(filePath, result.stamp, ingested);
     }
 
-    file.close();
     emit dataLoaded(true);
-    return true;
 }
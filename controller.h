@@ -2,21 +2,106 @@
 #define CONTROLLER_H
 
 #include "database.h"
+#include "csvloader.h"
 #include <QObject>
 #include <QString>
 #include <QDir>
 #include <QDebug>
+#include <QThreadPool>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
 
 class Controller : public QObject {
     Q_OBJECT
+public:
+    enum LoadMode {
+        StreamedLoad,
+        MappedLoad
+    };
+
 private:
+    enum LoadKind {
+        FullLoad,
+        AppendLoad,
+        PartitionedLoad
+    };
+
     DataBase* db;
+    LoadMode mode;
+    int threadCount;
+    bool snapshotsEnabled;
+    int lazyTextMegabytes;
+
+    // Loads run one at a time on this pool; a newer load supersedes older ones.
+    QThreadPool loaderPool;
+    std::shared_ptr<std::atomic<bool>> cancelFlag;
+    quint64 loadGeneration;
+    bool batchesCommitted;
+    LoadKind currentKind;
+
+    // What the last successful load ingested, for append-only reloads
+    QString loadedPath;
+    LoadKind loadedKind;
+    CsvLoader::Prefix ingested;
+    bool autoReload;
+    QFileSystemWatcher watcher;
+    QTimer reloadTimer;
+    // Partition files with their sizes and modification times, as of the last
+    // partitioned load and of the one in progress
+    QStringList loadedPartitions;
+    QStringList loadingPartitions;
+
+    void startLoading(const QString& filePath, LoadKind kind);
+    void updateWatchedFile();
+    bool releaseMappedText(const QString& filePath);
+    void loadedFileChanged();
+    static QStringList partitionListing(const QString& location);
+    void partitionDirectoryChanged();
+    void discardCommittedBatches();
+    void commitBatch(const QVector<Athlete>& batch, quint64 generation);
+    void finishLoading(const QString& filePath, const CsvLoader::Result& result, quint64 generation);
 
 public:
     explicit Controller(QObject *parent = nullptr);
-    bool loadCSV(const QString& filePath);
+    ~Controller();
+
+    // Starts parsing filePath on a worker thread and returns immediately.
+    void loadCSV(const QString& filePath);
+    // Loads every partition in a directory, or matching a wildcard pattern, as one dataset.
+    void loadPartitioned(const QString& location);
+    // Parses only the records appended to the loaded file since the last load;
+    // falls back to a full load when the file was rewritten.
+    void reloadAppended();
+    void cancelLoading();
+    bool isLoading() const { return cancelFlag != nullptr; }
+
+    void setLoadMode(LoadMode loadMode) { mode = loadMode; }
+    LoadMode loadMode() const { return mode; }
+
+    // Number of parser threads for mapped loads; 0 uses QThread::idealThreadCount().
+    void setThreadCount(int count);
+    int effectiveThreadCount() const;
+
+    // Warm starts read a binary snapshot next to the CSV instead of parsing it.
+    void setSnapshotsEnabled(bool enabled);
+    bool areSnapshotsEnabled() const { return snapshotsEnabled; }
+
+    // Names in plain files of at least this many megabytes stay in the mapped
+    // file instead of being copied; 0, the default, always copies them. While
+    // they are mapped the file is watched, and on Windows it cannot be replaced.
+    void setLazyTextThreshold(int megabytes);
+    int lazyTextThreshold() const { return lazyTextMegabytes; }
+
+    // Watches the loaded file and reloads appended records when it changes.
+    void setAutoReload(bool enabled);
+    bool isAutoReloadEnabled() const { return autoReload; }
 
 signals:
+    void loadingStarted(const QString& filePath);
+    void loadingCancelled();
     void dataLoaded(bool success);
     void progressUpdated(int progress);
 };
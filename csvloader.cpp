@@ -0,0 +1,616 @@
+#include "csvloader.h"
+#include "csvparser.h"
+#include "csvscanner.h"
+#include "csvschema.h"
+#include "datasnapshot.h"
+#include "mappedsource.h"
+#include "streamdecompressor.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+namespace {
+const qint64 MinChunkBytes = 1 << 20;
+const int ChunksPerThread = 4;
+const qint64 StreamBlockBytes = 4 << 20;
+const int DecodedBlockBytes = 4 << 20;
+const int DecodedQueueDepth = 4;
+const int DecodedWindowBytes = 16 << 20;
+const qint64 PrefixSampleBytes = 64 * 1024;
+const int HeaderProbeBytes = 64 * 1024;
+
+// Bounded hand-off between the decompressing thread and the parser. Closing
+// wakes both sides: the producer stops pushing and the consumer drains what is left.
+class BlockQueue {
+public:
+    explicit BlockQueue(int capacity) : capacity(capacity), closed(false) {}
+
+    void push(const QByteArray& block) {
+        QMutexLocker locker(&mutex);
+        while (blocks.size() >= capacity && !closed) {
+            notFull.wait(&mutex);
+        }
+        if (!closed) {
+            blocks.enqueue(block);
+            notEmpty.wakeOne();
+        }
+    }
+
+    bool pop(QByteArray& block) {
+        QMutexLocker locker(&mutex);
+        while (blocks.isEmpty() && !closed) {
+            notEmpty.wait(&mutex);
+        }
+        if (blocks.isEmpty()) {
+            return false;
+        }
+        block = blocks.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void close() {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<QByteArray> blocks;
+    int capacity;
+    bool closed;
+};
+
+bool bindSchema(const QVector<CsvField>& header, const QString& fileName, CsvSchema& schema) {
+    schema = CsvSchema::fromHeader(header);
+    if (!schema.isValid()) {
+        qDebug() << "No known columns in the header of" << fileName;
+        return false;
+    }
+    const QStringList missing = schema.missingColumns();
+    if (!missing.isEmpty()) {
+        qDebug() << "Columns missing from" << fileName << ":" << missing.join(", ");
+    }
+    return true;
+}
+
+// Parses [begin, end) in record-aligned chunks on pool. Chunks finish in any
+// order; whoever completes the next chunk in file order hands it over,
+// together with any later chunks already waiting. lastChunk receives where the
+// final chunk starts, a record boundary close to the end.
+int parseChunks(const char* begin, const char* end, const CsvSchema& schema, QThreadPool& pool,
+                const std::atomic<bool>& cancelled,
+                const std::function<void(qint64)>& chunkParsed, const CsvLoader::BatchCallback& batchReady,
+                const MappedSource* source = nullptr, const char** lastChunk = nullptr) {
+    const int threads = qMax(1, pool.maxThreadCount());
+    const int chunkCount = static_cast<int>(qMin<qint64>(threads * ChunksPerThread,
+                                                         qMax<qint64>(1, (end - begin) / MinChunkBytes)));
+    const QVector<const char*> boundaries = CsvParser::splitRecords(begin, end, chunkCount, pool);
+    const int batchCount = boundaries.size() - 1;
+    if (lastChunk) {
+        *lastChunk = boundaries.at(qMax(0, batchCount - 1));
+    }
+
+    QVector<QVector<Athlete>> batches(batchCount);
+    QVector<char> finished(batchCount, 0);
+    QMutex deliveryMutex;
+    int nextBatch = 0;
+    std::atomic<int> rows(0);
+
+    QVector<Athlete>* outputs = batches.data();
+    char* done = finished.data();
+    for (int i = 0; i < batchCount; ++i) {
+        const char* chunkBegin = boundaries.at(i);
+        const char* chunkEnd = boundaries.at(i + 1);
+        pool.start([=, &schema, &deliveryMutex, &nextBatch, &rows, &cancelled, &chunkParsed, &batchReady]() {
+            if (!cancelled) {
+                CsvParser::parseAthletes(chunkBegin, chunkEnd, schema, outputs[i], source);
+                rows += outputs[i].size();
+                chunkParsed(chunkEnd - chunkBegin);
+            }
+
+            QMutexLocker locker(&deliveryMutex);
+            done[i] = 1;
+            while (nextBatch < batchCount && done[nextBatch]) {
+                if (!cancelled) {
+                    batchReady(outputs[nextBatch]);
+                }
+                outputs[nextBatch] = QVector<Athlete>();
+                ++nextBatch;
+            }
+        });
+    }
+    pool.waitForDone();
+
+    return rows;
+}
+}
+
+CsvLoader::Result CsvLoader::load(const QString& filePath, const Options& options, const std::atomic<bool>& cancelled,
+                                  const ProgressCallback& progress, const BatchCallback& batchReady) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to open file:" << filePath;
+        return Result();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const StreamDecompressor::Format format = StreamDecompressor::detect(file);
+    if (!StreamDecompressor::isSupported(format)) {
+        qDebug() << "This build cannot read" << StreamDecompressor::formatName(format) << "input:" << filePath;
+        return Result();
+    }
+
+    Result snapshot;
+    if (options.useSnapshot && DataSnapshot::load(filePath, snapshot.table, snapshot.prefix)) {
+        qDebug() << "Loaded" << snapshot.table.size() << "rows from snapshot in" << timer.elapsed() << "ms";
+        progress(100);
+
+        snapshot.success = true;
+        snapshot.fromSnapshot = true;
+        snapshot.rows = snapshot.table.size();
+        return snapshot;
+    }
+
+    DataSnapshot::SourceStamp stamp;
+    DataSnapshot::stampSource(filePath, stamp);
+
+    Result result;
+    int threads = qMax(1, options.threadCount);
+    if (format != StreamDecompressor::PlainFormat) {
+        std::unique_ptr<StreamDecompressor> decompressor = StreamDecompressor::create(format, file);
+        result = loadCompressed(file, *decompressor, options, cancelled, progress, batchReady);
+    } else if (options.useMapping) {
+        result = loadMapped(file, options, cancelled, progress, batchReady);
+    } else {
+        result = loadStreamed(file, cancelled, progress, batchReady);
+        threads = 1;
+    }
+
+    if (result.success && result.prefix.bytes > 0) {
+        result.prefix.checksum = prefixChecksum(file, result.prefix.bytes);
+    }
+    result.stamp = stamp;
+
+    if (result.success) {
+        qDebug() << "Parsed" << result.rows << StreamDecompressor::formatName(format) << "rows in" << timer.elapsed()
+                 << "ms using" << threads << "threads and the"
+                 << CsvScanner::kernelName(CsvScanner::activeKernel()) << "scanner";
+    }
+    return result;
+}
+
+CsvLoader::Result CsvLoader::loadMapped(QFile& file, const Options& options, const std::atomic<bool>& cancelled,
+                                        const ProgressCallback& progress, const BatchCallback& batchReady) {
+    // A shared mapping can outlive the load, so names can stay in the file
+    std::shared_ptr<MappedSource> source = options.lazyText ? MappedSource::open(file.fileName()) : nullptr;
+    uchar* mapped = nullptr;
+    qint64 size = file.size();
+    const char* begin = nullptr;
+    if (source) {
+        size = source->size();
+        begin = source->data();
+    } else {
+        mapped = size > 0 ? file.map(0, size) : nullptr;
+        if (!mapped) {
+            qDebug() << "Memory mapping unavailable, falling back to streamed load:" << file.fileName();
+            return loadStreamed(file, cancelled, progress, batchReady);
+        }
+        begin = reinterpret_cast<const char*>(mapped);
+    }
+    const char* end = begin + size;
+    QVector<CsvField> header;
+    const char* dataBegin = CsvParser::parseRecord(begin, end, header);
+    CsvSchema schema;
+    if (!bindSchema(header, file.fileName(), schema)) {
+        if (mapped) {
+            file.unmap(mapped);
+        }
+        return Result();
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, options.threadCount));
+
+    std::atomic<qint64> parsedBytes(dataBegin - begin);
+    auto chunkParsed = [&parsedBytes, &progress, size](qint64 bytes) {
+        progress(static_cast<int>(((parsedBytes += bytes) * 100) / size));
+    };
+    const char* lastChunk = dataBegin;
+    const int rows = parseChunks(dataBegin, end, schema, pool, cancelled, chunkParsed, batchReady, source.get(),
+                                 &lastChunk);
+    const char* recordsEnd = CsvParser::lastRecordEnd(lastChunk, end);
+
+    if (mapped) {
+        file.unmap(mapped);
+    }
+
+    Result result;
+    result.cancelled = cancelled;
+    result.success = !result.cancelled;
+    result.rows = rows;
+    result.prefix.bytes = recordsEnd - begin;
+    result.prefix.unterminatedTail = recordsEnd < end;
+    result.source = source;
+    return result;
+}
+
+CsvLoader::Result CsvLoader::loadStreamed(QFile& file, const std::atomic<bool>& cancelled,
+                                          const ProgressCallback& progress, const BatchCallback& batchReady) {
+    Result result;
+    const qint64 size = file.size();
+
+    QByteArray pending;
+    CsvSchema schema;
+    bool headerSkipped = false;
+
+    while (!cancelled) {
+        const QByteArray block = file.read(StreamBlockBytes);
+        const bool atEnd = block.isEmpty();
+        pending.append(block);
+
+        const char* begin = pending.constData();
+        const char* end = begin + pending.size();
+        const char* recordsEnd = atEnd ? end : CsvParser::lastRecordEnd(begin, end);
+        if (atEnd) {
+            // What is left at the end had no line break after it
+            result.prefix.bytes = file.pos() - pending.size();
+            result.prefix.unterminatedTail = !pending.isEmpty();
+        }
+
+        if (!headerSkipped && recordsEnd > begin) {
+            QVector<CsvField> header;
+            begin = CsvParser::parseRecord(begin, recordsEnd, header);
+            if (!bindSchema(header, file.fileName(), schema)) {
+                return result;
+            }
+            headerSkipped = true;
+        }
+
+        if (recordsEnd > begin) {
+            QVector<Athlete> batch;
+            CsvParser::parseAthletes(begin, recordsEnd, schema, batch);
+            result.rows += batch.size();
+            batchReady(batch);
+        }
+        pending.remove(0, static_cast<int>(recordsEnd - pending.constData()));
+
+        if (size > 0) {
+            progress(static_cast<int>((file.pos() * 100) / size));
+        }
+        if (atEnd) {
+            break;
+        }
+    }
+
+    result.cancelled = cancelled;
+    result.success = !result.cancelled && file.error() == QFileDevice::NoError;
+    return result;
+}
+
+CsvLoader::Result CsvLoader::loadCompressed(QFile& file, StreamDecompressor& decompressor, const Options& options,
+                                            const std::atomic<bool>& cancelled,
+                                            const ProgressCallback& progress, const BatchCallback& batchReady) {
+    const qint64 size = file.size();
+    BlockQueue queue(DecodedQueueDepth);
+    std::atomic<bool> decodeFailed(false);
+    std::atomic<qint64> compressedPosition(0);
+
+    // Decompression runs one block ahead of tokenization on its own thread
+    QThreadPool decodePool;
+    decodePool.setMaxThreadCount(1);
+    decodePool.start([&]() {
+        bool atEnd = false;
+        while (!atEnd && !cancelled) {
+            QByteArray block;
+            if (!decompressor.read(block, DecodedBlockBytes, atEnd)) {
+                decodeFailed = true;
+                break;
+            }
+            compressedPosition = decompressor.inputPosition();
+            if (!block.isEmpty()) {
+                queue.push(block);
+            }
+        }
+        queue.close();
+    });
+
+    QThreadPool parsePool;
+    parsePool.setMaxThreadCount(qMax(1, options.threadCount));
+    auto chunkParsed = [&](qint64) {
+        if (size > 0) {
+            progress(static_cast<int>((compressedPosition * 100) / size));
+        }
+    };
+
+    Result result;
+    QByteArray pending;
+    QByteArray block;
+    CsvSchema schema;
+    bool headerSkipped = false;
+    bool atEnd = false;
+    bool headerValid = true;
+
+    while (!atEnd && !cancelled) {
+        atEnd = !queue.pop(block);
+        pending.append(block);
+        block.clear();
+        if (!atEnd && pending.size() < DecodedWindowBytes) {
+            continue;
+        }
+
+        const char* begin = pending.constData();
+        const char* end = begin + pending.size();
+        const char* recordsEnd = atEnd ? end : CsvParser::lastRecordEnd(begin, end);
+
+        if (!headerSkipped && recordsEnd > begin) {
+            QVector<CsvField> header;
+            begin = CsvParser::parseRecord(begin, recordsEnd, header);
+            headerSkipped = true;
+            headerValid = bindSchema(header, file.fileName(), schema);
+            if (!headerValid) {
+                break;
+            }
+        }
+
+        if (recordsEnd > begin) {
+            result.rows += parseChunks(begin, recordsEnd, schema, parsePool, cancelled, chunkParsed, batchReady);
+        }
+        pending.remove(0, static_cast<int>(recordsEnd - pending.constData()));
+    }
+
+    queue.close();
+    decodePool.waitForDone();
+
+    result.cancelled = cancelled;
+    result.success = !result.cancelled && !decodeFailed && headerValid;
+    return result;
+}
+
+CsvLoader::Result CsvLoader::loadAppended(const QString& filePath, const Prefix& previous, const Options& options,
+                                          const std::atomic<bool>& cancelled,
+                                          const ProgressCallback& progress, const BatchCallback& batchReady) {
+    Result result;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Failed to open file:" << filePath;
+        return result;
+    }
+    DataSnapshot::stampSource(filePath, result.stamp);
+
+    const qint64 size = file.size();
+    if (previous.bytes <= 0 || previous.unterminatedTail || size < previous.bytes
+        || StreamDecompressor::detect(file) != StreamDecompressor::PlainFormat
+        || prefixChecksum(file, previous.bytes) != previous.checksum) {
+        result.prefixChanged = true;
+        return result;
+    }
+
+    // Appended records follow the column layout of the header at the top of the file
+    QStringList headerNames;
+    if (!readHeader(filePath, headerNames)) {
+        return result;
+    }
+    const CsvSchema schema = CsvSchema::fromHeader(headerNames);
+
+    result.prefix = previous;
+    if (size > previous.bytes && file.seek(previous.bytes)) {
+        const QByteArray appended = file.read(size - previous.bytes);
+        const char* begin = appended.constData();
+        const char* recordsEnd = CsvParser::lastRecordEnd(begin, begin + appended.size());
+
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMax(1, options.threadCount));
+        QVector<Athlete> rows;
+        auto collect = [&rows](const QVector<Athlete>& batch) { rows += batch; };
+        parseChunks(begin, recordsEnd, schema, pool, cancelled, [](qint64) {}, collect);
+
+        if (!cancelled && !rows.isEmpty()) {
+            batchReady(rows);
+        }
+        result.rows = rows.size();
+        result.prefix.bytes = previous.bytes + (recordsEnd - begin);
+        result.prefix.checksum = prefixChecksum(file, result.prefix.bytes);
+    }
+    progress(100);
+
+    qDebug() << "Appended" << result.rows << "rows from" << (size - previous.bytes) << "new bytes";
+
+    result.cancelled = cancelled;
+    result.success = !result.cancelled && file.error() == QFileDevice::NoError;
+    return result;
+}
+
+bool CsvLoader::isPrefixIntact(const QString& filePath, const Prefix& prefix) {
+    QFile file(filePath);
+    return prefix.bytes > 0 && file.open(QIODevice::ReadOnly) && file.size() >= prefix.bytes
+        && prefixChecksum(file, prefix.bytes) == prefix.checksum;
+}
+
+// Hashes the head and tail of the prefix, like the snapshot stamp: cheap on
+// large files and enough to tell an append from a rewrite.
+QByteArray CsvLoader::prefixChecksum(QFile& file, qint64 bytes) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(QByteArray::number(bytes));
+
+    file.seek(0);
+    hash.addData(file.read(qMin(bytes, PrefixSampleBytes)));
+    if (bytes > PrefixSampleBytes) {
+        const qint64 tailStart = qMax(PrefixSampleBytes, bytes - PrefixSampleBytes);
+        file.seek(tailStart);
+        hash.addData(file.read(bytes - tailStart));
+    }
+    return hash.result();
+}
+
+QStringList CsvLoader::partitionFiles(const QString& location) {
+    const QFileInfo info(location);
+    QDir dir;
+    QStringList patterns;
+    if (info.isDir()) {
+        dir = QDir(location);
+        patterns << "*.csv" << "*.csv.gz" << "*.csv.zst";
+    } else {
+        dir = info.dir();
+        patterns << info.fileName();
+    }
+
+    // A wildcard can also match the partitions' snapshots and their temporary files
+    QStringList files;
+    for (const QString& name : dir.entryList(patterns, QDir::Files, QDir::Name)) {
+        if (!name.contains(QLatin1String(".snapshot"))) {
+            files << dir.filePath(name);
+        }
+    }
+    return files;
+}
+
+bool CsvLoader::readHeader(const QString& filePath, QStringList& header) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray head;
+    const StreamDecompressor::Format format = StreamDecompressor::detect(file);
+    if (format == StreamDecompressor::PlainFormat) {
+        head = file.read(HeaderProbeBytes);
+    } else {
+        std::unique_ptr<StreamDecompressor> decompressor = StreamDecompressor::create(format, file);
+        bool atEnd = false;
+        if (!decompressor || !decompressor->read(head, HeaderProbeBytes, atEnd)) {
+            return false;
+        }
+    }
+
+    QVector<CsvField> fields;
+    CsvParser::parseRecord(head.constData(), head.constData() + head.size(), fields);
+    header.clear();
+    for (const CsvField& field : fields) {
+        header << CsvParser::toString(field);
+    }
+    return !header.isEmpty();
+}
+
+CsvLoader::Result CsvLoader::loadPartitions(const QStringList& filePaths, const Options& options,
+                                            const std::atomic<bool>& cancelled,
+                                            const ProgressCallback& progress, const BatchCallback& batchReady) {
+    Result result;
+    if (filePaths.isEmpty()) {
+        qDebug() << "No partitions to load";
+        return result;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList expectedHeader;
+    QVector<qint64> sizes;
+    qint64 totalBytes = 0;
+    for (const QString& path : filePaths) {
+        QStringList header;
+        if (!readHeader(path, header)) {
+            qDebug() << "Failed to read partition header:" << path;
+            return result;
+        }
+        if (expectedHeader.isEmpty()) {
+            expectedHeader = header;
+        } else if (header != expectedHeader) {
+            qDebug() << "Partition header does not match" << filePaths.first() << ":" << path;
+            return result;
+        }
+        sizes.append(QFileInfo(path).size());
+        totalBytes += sizes.last();
+    }
+
+    // Partitions are the unit of parallelism, so each one is parsed on a single thread.
+    // Their rows are merged after the per-partition results are gone, so names are copied.
+    Options partitionOptions = options;
+    partitionOptions.threadCount = 1;
+    partitionOptions.lazyText = false;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, options.threadCount));
+
+    QVector<QVector<Athlete>> partitions(filePaths.size());
+    QVector<char> loaded(filePaths.size(), 0);
+    std::atomic<qint64> loadedBytes(0);
+
+    QVector<Athlete>* outputs = partitions.data();
+    char* succeeded = loaded.data();
+    for (int i = 0; i < filePaths.size(); ++i) {
+        const QString path = filePaths.at(i);
+        const qint64 bytes = sizes.at(i);
+        pool.start([=, &cancelled, &progress, &loadedBytes]() {
+            QVector<Athlete>& rows = outputs[i];
+            auto collect = [&rows](const QVector<Athlete>& batch) { rows += batch; };
+            const Result partition = load(path, partitionOptions, cancelled, [](int) {}, collect);
+            succeeded[i] = partition.success;
+
+            // Partitions are merged row by row, so snapshot tables are spread back into rows
+            if (partition.fromSnapshot) {
+                rows.reserve(partition.table.size());
+                for (int row = 0; row < partition.table.size(); ++row) {
+                    rows.append(partition.table.athlete(row));
+                }
+            }
+
+            // Each partition keeps its own snapshot, so adding a file only parses that file next time
+            if (partition.success && partitionOptions.useSnapshot && !partition.fromSnapshot) {
+                const QVector<Athlete> snapshotRows = rows;
+                const DataSnapshot::SourceStamp stamp = partition.stamp;
+                const Prefix prefix = partition.prefix;
+                QThreadPool::globalInstance()->start([path, snapshotRows, stamp, prefix]() {
+                    AthleteTable table;
+                    table.append(snapshotRows);
+                    DataSnapshot::save(path, table, stamp, prefix);
+                });
+            }
+            progress(static_cast<int>(((loadedBytes += bytes) * 100) / qMax<qint64>(1, totalBytes)));
+        });
+    }
+    pool.waitForDone();
+
+    result.cancelled = cancelled;
+    if (result.cancelled) {
+        return result;
+    }
+    for (int i = 0; i < filePaths.size(); ++i) {
+        if (!loaded.at(i)) {
+            qDebug() << "Failed to load partition:" << filePaths.at(i);
+            return result;
+        }
+    }
+
+    int rows = 0;
+    for (const QVector<Athlete>& partition : partitions) {
+        rows += partition.size();
+    }
+    QVector<Athlete> merged;
+    merged.reserve(rows);
+    for (QVector<Athlete>& partition : partitions) {
+        merged += partition;
+        partition = QVector<Athlete>();
+    }
+    batchReady(merged);
+
+    qDebug() << "Loaded" << rows << "rows from" << filePaths.size() << "partitions in" << timer.elapsed() << "ms";
+
+    result.success = true;
+    result.rows = rows;
+    return result;
+}
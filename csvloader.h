@@ -0,0 +1,94 @@
+#ifndef CSVLOADER_H
+#define CSVLOADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "database.h"
+#include "datasnapshot.h"
+
+class QFile;
+class MappedSource;
+class StreamDecompressor;
+
+// Parses a CSV file off the GUI thread. The loader never touches DataBase;
+// parsed rows are handed to the caller as batches, always in file order, or
+// as a finished table when they come from a snapshot.
+// gzip and zstd input is recognised by its magic bytes and decoded on the fly.
+class CsvLoader {
+public:
+    struct Options {
+        bool useMapping = true;
+        bool useSnapshot = true;
+        int threadCount = 1;
+        // Mapped plain files keep names in the file; rows then need Result::source alive
+        bool lazyText = false;
+    };
+
+    // The part of a plain CSV already ingested, so a reload can parse only what was appended.
+    typedef DataSnapshot::Prefix Prefix;
+
+    struct Result {
+        bool success = false;
+        bool cancelled = false;
+        bool fromSnapshot = false;
+        // Set by loadAppended() when the ingested bytes were rewritten or truncated,
+    // or when the previous load ended in a record without a line break
+        bool prefixChanged = false;
+        int rows = 0;
+        Prefix prefix;
+        // The source as it was when parsing started, for saving a snapshot of the rows
+        DataSnapshot::SourceStamp stamp;
+        // A load served from a snapshot delivers no batches; its rows come whole in here
+        AthleteTable table;
+        // The mapping that lazily loaded rows point into. Holding the result
+        // until every batch is stored keeps it open; the table takes over from there.
+        std::shared_ptr<MappedSource> source;
+    };
+
+    typedef std::function<void(int)> ProgressCallback;
+    // Called from worker threads, serialized and in file order.
+    typedef std::function<void(const QVector<Athlete>&)> BatchCallback;
+
+    static Result load(const QString& filePath, const Options& options, const std::atomic<bool>& cancelled,
+                       const ProgressCallback& progress, const BatchCallback& batchReady);
+
+    // Parses the complete records appended after previous and delivers them as a
+    // single batch. A half-written last line is left for the next reload.
+    static Result loadAppended(const QString& filePath, const Prefix& previous, const Options& options,
+                               const std::atomic<bool>& cancelled,
+                               const ProgressCallback& progress, const BatchCallback& batchReady);
+
+    // True while filePath still starts with the bytes prefix describes.
+    static bool isPrefixIntact(const QString& filePath, const Prefix& prefix);
+
+    // A directory (every *.csv, *.csv.gz and *.csv.zst in it) or a wildcard
+    // pattern such as "datasets/games_*.csv", resolved in name order.
+    static QStringList partitionFiles(const QString& location);
+
+    // Parses the partitions concurrently, one per task, after checking that
+    // their headers match. All rows are delivered as one batch in file order.
+    static Result loadPartitions(const QStringList& filePaths, const Options& options,
+                                 const std::atomic<bool>& cancelled,
+                                 const ProgressCallback& progress, const BatchCallback& batchReady);
+
+private:
+    static QByteArray prefixChecksum(QFile& file, qint64 bytes);
+    static bool readHeader(const QString& filePath, QStringList& header);
+
+    static Result loadMapped(QFile& file, const Options& options, const std::atomic<bool>& cancelled,
+                             const ProgressCallback& progress, const BatchCallback& batchReady);
+    static Result loadStreamed(QFile& file, const std::atomic<bool>& cancelled,
+                               const ProgressCallback& progress, const BatchCallback& batchReady);
+    static Result loadCompressed(QFile& file, StreamDecompressor& decompressor, const Options& options,
+                                 const std::atomic<bool>& cancelled,
+                                 const ProgressCallback& progress, const BatchCallback& batchReady);
+};
+
+#endif // CSVLOADER_H
@@ -0,0 +1,249 @@
+#include "csvparser.h"
+#include "csvscanner.h"
+#include "csvschema.h"
+
+#include <QByteArray>
+#include <QThreadPool>
+#include <QtAlgorithms>
+
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+CsvField makeField(const char* begin, const char* end) {
+    while (begin < end && isBlank(*begin)) {
+        ++begin;
+    }
+    while (end > begin && isBlank(*(end - 1))) {
+        --end;
+    }
+
+    bool escaped = false;
+    if (end - begin >= 2 && *begin == '\"' && *(end - 1) == '\"') {
+        ++begin;
+        --end;
+        escaped = std::memchr(begin, '\"', end - begin) != nullptr;
+    }
+
+    return CsvField{begin, end, escaped};
+}
+
+const float PowersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f};
+
+}
+
+bool CsvField::equals(const char* text, int length) const {
+    return size() == length && std::memcmp(begin, text, length) == 0;
+}
+
+const char* CsvParser::parseRecord(const char* pos, const char* end, QVector<CsvField>& fields) {
+    fields.clear();
+
+    const char* fieldStart = pos;
+    bool inQuotes = false;
+
+    while (pos < end) {
+        char c = *pos;
+
+        if (c == '\"') {
+            inQuotes = !inQuotes;
+        } else if (!inQuotes) {
+            if (c == ',') {
+                fields.append(makeField(fieldStart, pos));
+                fieldStart = pos + 1;
+            } else if (c == '\n') {
+                fields.append(makeField(fieldStart, pos));
+                return pos + 1;
+            }
+        }
+        ++pos;
+    }
+
+    fields.append(makeField(fieldStart, end));
+    return end;
+}
+
+void CsvParser::parseAthletes(const char* begin, const char* end, const CsvSchema& schema, QVector<Athlete>& athletes,
+                              const MappedSource* source) {
+    athletes.reserve(athletes.size() + static_cast<int>((end - begin) / 140));
+
+    // Fields are decoded as soon as their delimiter is found, straight into the row
+    CsvDecodeState state(source);
+    Athlete athlete = schema.emptyRow();
+    int column = 0;
+
+    const char* fieldStart = begin;
+    quint64 quoteCarry = 0;
+    CsvBlockMasks masks;
+
+    for (const char* block = begin; block < end; block += CsvScanner::BlockSize) {
+        const int length = static_cast<int>(qMin<qint64>(CsvScanner::BlockSize, end - block));
+        CsvScanner::scanBlock(block, length, masks);
+
+        const quint64 quoted = CsvScanner::quotedRegions(masks.quotes, quoteCarry);
+        quint64 delimiters = (masks.commas | masks.newlines) & ~quoted;
+
+        while (delimiters) {
+            const int offset = qCountTrailingZeroBits(delimiters);
+            const char* pos = block + offset;
+            schema.decode(column++, makeField(fieldStart, pos), athlete, state);
+            fieldStart = pos + 1;
+
+            if (masks.newlines & (quint64(1) << offset)) {
+                if (column >= schema.minimumFields()) {
+                    athletes.append(athlete);
+                }
+                athlete = schema.emptyRow();
+                column = 0;
+            }
+            delimiters &= delimiters - 1;
+        }
+    }
+
+    if (fieldStart < end || column > 0) {
+        schema.decode(column++, makeField(fieldStart, end), athlete, state);
+        if (column >= schema.minimumFields()) {
+            athletes.append(athlete);
+        }
+    }
+}
+
+QVector<const char*> CsvParser::splitRecords(const char* begin, const char* end, int chunkCount, QThreadPool& pool) {
+    const qint64 size = end - begin;
+    chunkCount = qMax(1, chunkCount);
+
+    QVector<const char*> starts(chunkCount + 1);
+    for (int i = 0; i <= chunkCount; ++i) {
+        starts[i] = begin + (size * i) / chunkCount;
+    }
+
+    QVector<int> quotes(chunkCount);
+    const char* const* ranges = starts.constData();
+    int* counts = quotes.data();
+    for (int i = 0; i < chunkCount; ++i) {
+        pool.start([ranges, counts, i]() {
+            counts[i] = static_cast<int>(CsvScanner::countQuotes(ranges[i], ranges[i + 1]) & 1);
+        });
+    }
+    pool.waitForDone();
+
+    QVector<const char*> boundaries;
+    boundaries.append(begin);
+
+    bool inQuotes = false;
+    for (int i = 1; i < chunkCount; ++i) {
+        inQuotes ^= (quotes[i - 1] & 1) != 0;
+        const char* boundary = nextRecordStart(starts[i], end, inQuotes);
+        if (boundary > boundaries.last() && boundary < end) {
+            boundaries.append(boundary);
+        }
+    }
+
+    boundaries.append(end);
+    return boundaries;
+}
+
+const char* CsvParser::nextRecordStart(const char* pos, const char* end, bool inQuotes) {
+    for (; pos < end; ++pos) {
+        if (*pos == '\"') {
+            inQuotes = !inQuotes;
+        } else if (*pos == '\n' && !inQuotes) {
+            return pos + 1;
+        }
+    }
+    return end;
+}
+
+const char* CsvParser::lastRecordEnd(const char* begin, const char* end) {
+    const char* recordEnd = begin;
+    quint64 quoteCarry = 0;
+    CsvBlockMasks masks;
+
+    for (const char* block = begin; block < end; block += CsvScanner::BlockSize) {
+        const int length = static_cast<int>(qMin<qint64>(CsvScanner::BlockSize, end - block));
+        CsvScanner::scanBlock(block, length, masks);
+
+        const quint64 newlines = masks.newlines & ~CsvScanner::quotedRegions(masks.quotes, quoteCarry);
+        if (newlines) {
+            recordEnd = block + (63 - qCountLeadingZeroBits(newlines)) + 1;
+        }
+    }
+    return recordEnd;
+}
+
+QString CsvParser::toString(const CsvField& field) {
+    if (!field.escaped) {
+        return QString::fromUtf8(field.begin, field.size());
+    }
+    return QString::fromUtf8(toUtf8(field));
+}
+
+QByteArray CsvParser::toUtf8(const CsvField& field) {
+    if (!field.escaped) {
+        return QByteArray(field.begin, field.size());
+    }
+
+    QByteArray unescaped;
+    unescaped.reserve(field.size());
+    for (const char* c = field.begin; c < field.end; ++c) {
+        unescaped.append(*c);
+        if (*c == '\"' && c + 1 < field.end && c[1] == '\"') {
+            ++c;
+        }
+    }
+    return unescaped;
+}
+
+int CsvParser::toInteger(const CsvField& field) {
+    int value = 0;
+    std::from_chars(field.begin, field.end, value);
+    return value;
+}
+
+// Plain decimals of up to seven digits ("82.5", "-3") are exact in a float and
+// decoded inline; anything else goes through QByteArray, which is locale-free as well.
+float CsvParser::toMeasurement(const CsvField& field) {
+    if (field.size() == 0 || field.equals("NA", 2)) {
+        return Athlete::missingValue();
+    }
+
+    const char* c = field.begin;
+    const bool negative = *c == '-';
+    if (negative || *c == '+') {
+        ++c;
+    }
+
+    quint32 mantissa = 0;
+    int digits = 0;
+    int fractionDigits = -1;
+    for (; c < field.end; ++c) {
+        if (*c >= '0' && *c <= '9') {
+            mantissa = mantissa * 10 + static_cast<quint32>(*c - '0');
+            ++digits;
+            if (fractionDigits >= 0) {
+                ++fractionDigits;
+            }
+        } else if (*c == '.' && fractionDigits < 0) {
+            fractionDigits = 0;
+        } else {
+            break;
+        }
+    }
+
+    if (c != field.end || digits == 0 || digits > 7) {
+        bool ok = false;
+        const float value = QByteArray::fromRawData(field.begin, field.size()).toFloat(&ok);
+        return ok ? value : Athlete::missingValue();
+    }
+
+    float value = static_cast<float>(mantissa);
+    if (fractionDigits > 0) {
+        value /= PowersOfTen[fractionDigits];
+    }
+    return negative ? -value : value;
+}
@@ -0,0 +1,52 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "database.h"
+
+class QThreadPool;
+class CsvSchema;
+class MappedSource;
+
+// A field inside a raw UTF-8 buffer. The span excludes surrounding quotes and
+// whitespace; escaped is set when the field still contains doubled quotes.
+struct CsvField {
+    const char* begin;
+    const char* end;
+    bool escaped;
+
+    int size() const { return static_cast<int>(end - begin); }
+    bool equals(const char* text, int length) const;
+};
+
+class CsvParser {
+public:
+    // Tokenizes one record starting at pos and returns the start of the next one.
+    static const char* parseRecord(const char* pos, const char* end, QVector<CsvField>& fields);
+
+    // Parses every record in [begin, end) and appends the resulting athletes.
+    // With a source, [begin, end) must lie inside it and names stay there.
+    static void parseAthletes(const char* begin, const char* end, const CsvSchema& schema, QVector<Athlete>& athletes,
+                              const MappedSource* source = nullptr);
+
+    // Splits [begin, end) into at most chunkCount ranges that start on record
+    // boundaries. Quote parity is counted in parallel so quoted newlines never split a record.
+    static QVector<const char*> splitRecords(const char* begin, const char* end, int chunkCount, QThreadPool& pool);
+
+    static const char* nextRecordStart(const char* pos, const char* end, bool inQuotes);
+
+    // Returns the end of the last complete record in [begin, end), which must start on a record boundary.
+    static const char* lastRecordEnd(const char* begin, const char* end);
+
+    static QString toString(const CsvField& field);
+    // The field's bytes with doubled quotes collapsed, without converting to UTF-16.
+    static QByteArray toUtf8(const CsvField& field);
+    // Locale-free numeric decoding from the raw bytes; NA and empty measurements are null.
+    static int toInteger(const CsvField& field);
+    static float toMeasurement(const CsvField& field);
+};
+
+#endif // CSVPARSER_H
@@ -0,0 +1,177 @@
+#include "csvscanner.h"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define CSVSCANNER_X86
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#    define CSVSCANNER_AVX2_TARGET
+#  else
+#    define CSVSCANNER_AVX2_TARGET __attribute__((target("avx2")))
+#  endif
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define CSVSCANNER_SSE2
+#  endif
+#endif
+
+namespace {
+
+typedef void (*ScanKernel)(const char* block, CsvBlockMasks& masks);
+
+void scanScalar(const char* block, CsvBlockMasks& masks) {
+    quint64 quotes = 0;
+    quint64 commas = 0;
+    quint64 newlines = 0;
+    for (int i = 0; i < CsvScanner::BlockSize; ++i) {
+        const quint64 bit = quint64(1) << i;
+        quotes |= block[i] == '\"' ? bit : 0;
+        commas |= block[i] == ',' ? bit : 0;
+        newlines |= block[i] == '\n' ? bit : 0;
+    }
+    masks.quotes = quotes;
+    masks.commas = commas;
+    masks.newlines = newlines;
+}
+
+#ifdef CSVSCANNER_SSE2
+quint64 matchSSE2(const __m128i (&chunks)[4], char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    quint64 mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        const quint64 bits = static_cast<quint16>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], needle)));
+        mask |= bits << (16 * i);
+    }
+    return mask;
+}
+
+void scanSSE2(const char* block, CsvBlockMasks& masks) {
+    const __m128i chunks[4] = {
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48))
+    };
+    masks.quotes = matchSSE2(chunks, '\"');
+    masks.commas = matchSSE2(chunks, ',');
+    masks.newlines = matchSSE2(chunks, '\n');
+}
+#endif
+
+#ifdef CSVSCANNER_X86
+CSVSCANNER_AVX2_TARGET quint64 matchAVX2(__m256i low, __m256i high, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    const quint64 lowBits = static_cast<quint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle)));
+    const quint64 highBits = static_cast<quint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle)));
+    return lowBits | (highBits << 32);
+}
+
+CSVSCANNER_AVX2_TARGET void scanAVX2(const char* block, CsvBlockMasks& masks) {
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    masks.quotes = matchAVX2(low, high, '\"');
+    masks.commas = matchAVX2(low, high, ',');
+    masks.newlines = matchAVX2(low, high, '\n');
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+CsvScanner::Kernel detectKernel() {
+#ifdef CSVSCANNER_X86
+    if (cpuHasAVX2()) {
+        return CsvScanner::AVX2Kernel;
+    }
+#endif
+#ifdef CSVSCANNER_SSE2
+    return CsvScanner::SSE2Kernel;
+#else
+    return CsvScanner::ScalarKernel;
+#endif
+}
+
+ScanKernel kernelFunction(CsvScanner::Kernel kernel) {
+    switch (kernel) {
+#ifdef CSVSCANNER_X86
+    case CsvScanner::AVX2Kernel: return scanAVX2;
+#endif
+#ifdef CSVSCANNER_SSE2
+    case CsvScanner::SSE2Kernel: return scanSSE2;
+#endif
+    default: return scanScalar;
+    }
+}
+
+ScanKernel activeScanKernel() {
+    static const ScanKernel kernel = kernelFunction(CsvScanner::activeKernel());
+    return kernel;
+}
+
+}
+
+CsvScanner::Kernel CsvScanner::activeKernel() {
+    static const Kernel kernel = detectKernel();
+    return kernel;
+}
+
+const char* CsvScanner::kernelName(Kernel kernel) {
+    switch (kernel) {
+    case SSE2Kernel: return "SSE2";
+    case AVX2Kernel: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+void CsvScanner::scanBlock(const char* block, int length, CsvBlockMasks& masks) {
+    if (length >= BlockSize) {
+        activeScanKernel()(block, masks);
+        return;
+    }
+
+    char padded[BlockSize] = {};
+    std::memcpy(padded, block, qMax(0, length));
+    activeScanKernel()(padded, masks);
+}
+
+quint64 CsvScanner::quotedRegions(quint64 quotes, quint64& carry) {
+    // Prefix XOR: bit i ends up set when an odd number of quotes precede or sit at i.
+    quint64 regions = quotes;
+    regions ^= regions << 1;
+    regions ^= regions << 2;
+    regions ^= regions << 4;
+    regions ^= regions << 8;
+    regions ^= regions << 16;
+    regions ^= regions << 32;
+    regions ^= carry;
+
+    carry = (regions >> 63) ? ~quint64(0) : 0;
+    return regions;
+}
+
+qint64 CsvScanner::countQuotes(const char* begin, const char* end) {
+    qint64 count = 0;
+    CsvBlockMasks masks;
+    for (const char* block = begin; block < end; block += BlockSize) {
+        scanBlock(block, static_cast<int>(qMin<qint64>(BlockSize, end - block)), masks);
+        count += qPopulationCount(masks.quotes);
+    }
+    return count;
+}
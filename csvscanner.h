@@ -0,0 +1,36 @@
+#ifndef CSVSCANNER_H
+#define CSVSCANNER_H
+
+#include <QtGlobal>
+
+// Classification of one 64-byte block: bit i is set when byte i matches.
+struct CsvBlockMasks {
+    quint64 quotes;
+    quint64 commas;
+    quint64 newlines;
+};
+
+class CsvScanner {
+public:
+    enum Kernel {
+        ScalarKernel,
+        SSE2Kernel,
+        AVX2Kernel
+    };
+
+    static constexpr int BlockSize = 64;
+
+    // Picks the widest kernel the CPU supports the first time it is called.
+    static Kernel activeKernel();
+    static const char* kernelName(Kernel kernel);
+
+    // Scans BlockSize bytes, or fewer when length is smaller (the rest reads as zero).
+    static void scanBlock(const char* block, int length, CsvBlockMasks& masks);
+
+    // Marks the bytes that lie inside quotes, carrying the state across blocks.
+    static quint64 quotedRegions(quint64 quotes, quint64& carry);
+
+    static qint64 countQuotes(const char* begin, const char* end);
+};
+
+#endif // CSVSCANNER_H
@@ -0,0 +1,133 @@
+#include "csvschema.h"
+#include "csvparser.h"
+#include "mappedsource.h"
+
+namespace {
+
+template <int Athlete::* Member>
+void decodeInteger(const CsvField& field, Athlete& athlete, CsvDecodeState&) {
+    athlete.*Member = CsvParser::toInteger(field);
+}
+
+template <float Athlete::* Member>
+void decodeMeasurement(const CsvField& field, Athlete& athlete, CsvDecodeState&) {
+    athlete.*Member = CsvParser::toMeasurement(field);
+}
+
+// Names are rarely looked at, so with a mapped source only their position is kept
+void decodeName(const CsvField& field, Athlete& athlete, CsvDecodeState& state) {
+    const MappedSource* source = state.textSource();
+    if (source && field.size() <= TextColumn::MaxLength) {
+        athlete.nameSpan.offset = field.begin - source->data();
+        athlete.nameSpan.length = field.size();
+        athlete.nameSpan.source = source->id();
+        athlete.nameSpan.escaped = field.escaped;
+    } else {
+        athlete.name = CsvParser::toUtf8(field);
+    }
+}
+
+template <QString Athlete::* Member, CsvDecodeState::Slot Slot>
+void decodeDictionary(const CsvField& field, Athlete& athlete, CsvDecodeState& state) {
+    athlete.*Member = state.intern(Slot, field);
+}
+
+// Medal is the one enumerated column where NA means "none"
+void decodeMedal(const CsvField& field, Athlete& athlete, CsvDecodeState& state) {
+    athlete.medal = field.equals("NA", 2) ? QString() : state.intern(CsvDecodeState::MedalSlot, field);
+}
+
+struct ColumnBinding {
+    const char* name;
+    CsvSchema::Decoder decoder;
+};
+
+const ColumnBinding Bindings[] = {
+    {"ID", &decodeInteger<&Athlete::id>},
+    {"Name", &decodeName},
+    {"Sex", &decodeDictionary<&Athlete::sex, CsvDecodeState::SexSlot>},
+    {"Age", &decodeMeasurement<&Athlete::age>},
+    {"Height", &decodeMeasurement<&Athlete::height>},
+    {"Weight", &decodeMeasurement<&Athlete::weight>},
+    {"Team", &decodeDictionary<&Athlete::team, CsvDecodeState::TeamSlot>},
+    {"NOC", &decodeDictionary<&Athlete::noc, CsvDecodeState::NocSlot>},
+    {"Games", &decodeDictionary<&Athlete::games, CsvDecodeState::GamesSlot>},
+    {"Year", &decodeInteger<&Athlete::year>},
+    {"Season", &decodeDictionary<&Athlete::season, CsvDecodeState::SeasonSlot>},
+    {"City", &decodeDictionary<&Athlete::city, CsvDecodeState::CitySlot>},
+    {"Sport", &decodeDictionary<&Athlete::sport, CsvDecodeState::SportSlot>},
+    {"Event", &decodeDictionary<&Athlete::event, CsvDecodeState::EventSlot>},
+    {"Medal", &decodeMedal}
+};
+
+const int BindingCount = sizeof(Bindings) / sizeof(Bindings[0]);
+
+}
+
+QString CsvDecodeState::intern(Slot slot, const CsvField& field) {
+    QHash<QByteArray, QString>& dictionary = values[slot];
+
+    // The probe key borrows the field bytes; only new values are copied
+    const QByteArray key = QByteArray::fromRawData(field.begin, field.size());
+    auto it = dictionary.constFind(key);
+    if (it == dictionary.constEnd()) {
+        it = dictionary.insert(QByteArray(field.begin, field.size()), CsvParser::toString(field));
+    }
+    return it.value();
+}
+
+CsvSchema::CsvSchema()
+    : requiredFields(0)
+    , boundColumns(0)
+{
+    defaults.id = 0;
+    defaults.age = Athlete::missingValue();
+    defaults.height = Athlete::missingValue();
+    defaults.weight = Athlete::missingValue();
+    defaults.year = 0;
+}
+
+CsvSchema CsvSchema::fromHeader(const QStringList& header) {
+    CsvSchema schema;
+    schema.decoders.fill(nullptr, header.size());
+
+    for (int column = 0; column < header.size(); ++column) {
+        QString name = header.at(column).trimmed();
+        if (column == 0 && name.startsWith(QChar(0xFEFF))) {
+            name = name.mid(1);  // UTF-8 byte order mark written by spreadsheet exports
+        }
+        for (int binding = 0; binding < BindingCount; ++binding) {
+            const quint32 bit = quint32(1) << binding;
+            // The first column with a given name wins; duplicates are skipped like unknown columns
+            if ((schema.boundColumns & bit) == 0
+                && name.compare(QLatin1String(Bindings[binding].name), Qt::CaseInsensitive) == 0) {
+                schema.decoders[column] = Bindings[binding].decoder;
+                schema.boundColumns |= bit;
+                schema.requiredFields = column + 1;
+                break;
+            }
+        }
+    }
+
+    // Trailing unknown columns are not needed to decode a record
+    schema.decoders.resize(schema.requiredFields);
+    return schema;
+}
+
+CsvSchema CsvSchema::fromHeader(const QVector<CsvField>& header) {
+    QStringList names;
+    for (const CsvField& field : header) {
+        names << CsvParser::toString(field);
+    }
+    return fromHeader(names);
+}
+
+QStringList CsvSchema::missingColumns() const {
+    QStringList missing;
+    for (int binding = 0; binding < BindingCount; ++binding) {
+        if ((boundColumns & (quint32(1) << binding)) == 0) {
+            missing << QLatin1String(Bindings[binding].name);
+        }
+    }
+    return missing;
+}
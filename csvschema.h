@@ -0,0 +1,78 @@
+#ifndef CSVSCHEMA_H
+#define CSVSCHEMA_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "database.h"
+
+struct CsvField;
+class MappedSource;
+
+// Per-parse interning of repeated text values. Each chunk owns one, so rows
+// share a single QString per distinct team, city, event and so on. When the
+// input is a mapped source that outlives the parse, names are left in it.
+class CsvDecodeState {
+public:
+    enum Slot {
+        SexSlot,
+        TeamSlot,
+        NocSlot,
+        GamesSlot,
+        SeasonSlot,
+        CitySlot,
+        SportSlot,
+        EventSlot,
+        MedalSlot,
+        SlotCount
+    };
+
+    explicit CsvDecodeState(const MappedSource* source = nullptr) : source(source) {}
+
+    QString intern(Slot slot, const CsvField& field);
+    const MappedSource* textSource() const { return source; }
+
+private:
+    QHash<QByteArray, QString> values[SlotCount];
+    const MappedSource* source;
+};
+
+// Maps header columns to Athlete fields by name. The decoder for each column
+// is picked once per file, so the parse loop only indexes a table; columns
+// with unknown names have no decoder and are skipped.
+class CsvSchema {
+public:
+    typedef void (*Decoder)(const CsvField& field, Athlete& athlete, CsvDecodeState& state);
+
+    CsvSchema();
+
+    static CsvSchema fromHeader(const QStringList& header);
+    static CsvSchema fromHeader(const QVector<CsvField>& header);
+
+    // At least one known column has to be present.
+    bool isValid() const { return requiredFields > 0; }
+    QStringList missingColumns() const;
+
+    // Records with fewer fields than this are treated as blank or truncated.
+    int minimumFields() const { return requiredFields; }
+
+    // Missing measurements default to null, everything else to empty or zero.
+    const Athlete& emptyRow() const { return defaults; }
+
+    void decode(int column, const CsvField& field, Athlete& athlete, CsvDecodeState& state) const {
+        if (column < decoders.size() && decoders.at(column)) {
+            decoders.at(column)(field, athlete, state);
+        }
+    }
+
+private:
+    QVector<Decoder> decoders;
+    int requiredFields;
+    quint32 boundColumns;
+    Athlete defaults;
+};
+
+#endif // CSVSCHEMA_H
@@ -1,8 +1,12 @@
 #include "database.h"
 
+#include <QThreadPool>
+
+#include <algorithm>
+
 DataBase* DataBase::instance = nullptr;
 
-DataBase::DataBase(QObject *parent) : QObject(parent) {
+DataBase::DataBase(QObject *parent) : QObject(parent), transactionDepth(0), streaming(false) {
 }
 
 DataBase* DataBase::getInstance() {
@@ -13,11 +17,228 @@ DataBase* DataBase::getInstance() {
 }
 
 void DataBase::addAthlete(const Athlete& athlete) {
-    athletes.append(athlete);
-    emit dataChanged();
+    beginTransaction();
+    pending.append(athlete);
+    commit();
 }
 
 void DataBase::clear() {
-    athletes.clear();
+    emit aboutToBeCleared();
+    table.clear();
+    pending.clear();
+    for (PostingIndex& index : indexes) {
+        index.clear();
+    }
+    sortIndexes.clear();
+    emit cleared();
     emit dataChanged();
 }
+
+void DataBase::reserve(int rows) {
+    table.reserve(rows);
+    pending.reserve(qMax(0, rows - table.size()));
+}
+
+void DataBase::beginTransaction() {
+    ++transactionDepth;
+}
+
+void DataBase::appendBatch(const QVector<Athlete>& batch) {
+    beginTransaction();
+    if (pending.isEmpty() && pending.capacity() < batch.size()) {
+        pending = batch;
+    } else {
+        pending.append(batch);
+    }
+    commit();
+}
+
+int DataBase::commit() {
+    if (transactionDepth > 0) {
+        --transactionDepth;
+    }
+    if (transactionDepth > 0 || pending.isEmpty()) {
+        return 0;
+    }
+
+    const int first = table.size();
+    const int last = first + pending.size() - 1;
+
+    emit rowsAboutToBeAppended(first, last);
+    table.append(pending);
+    pending.clear();
+    indexRows(first);
+    sortIndexes.clear();
+    emit rowsAppended(first, last);
+    emit dataChanged();
+
+    return last - first + 1;
+}
+
+void DataBase::rollback() {
+    if (transactionDepth > 0) {
+        --transactionDepth;
+    }
+    if (transactionDepth == 0) {
+        pending.clear();
+    }
+}
+
+void DataBase::setTable(const AthleteTable& rows) {
+    clear();
+    if (rows.isEmpty()) {
+        return;
+    }
+
+    const int last = rows.size() - 1;
+    emit rowsAboutToBeAppended(0, last);
+    table = rows;
+    indexRows(0);
+    emit rowsAppended(0, last);
+    emit dataChanged();
+}
+
+void DataBase::indexRows(int first) {
+    const QVector<quint8>& flags = table.flags();
+    for (int row = first; row < table.size(); ++row) {
+        indexes[NocIndex].add(table.nocs().code(row), row);
+        indexes[SportIndex].add(table.sports().code(row), row);
+        indexes[SeasonIndex].add(flags.at(row) & AthleteTable::SeasonMask, row);
+        indexes[MedalIndex].add(flags.at(row) & AthleteTable::MedalMask, row);
+        indexes[YearIndex].add(static_cast<quint32>(table.years().at(row)), row);
+    }
+}
+
+RowBitmap DataBase::rowsEqualTo(IndexedColumn column, const QString& value, Qt::CaseSensitivity cs) const {
+    const PostingIndex& index = indexes[column];
+    RowBitmap rows;
+
+    switch (column) {
+    case NocIndex:
+    case SportIndex: {
+        // Dictionaries are small, and a case-insensitive match can cover several codes
+        const StringDictionary& dictionary = (column == NocIndex ? table.nocs() : table.sports()).dictionary();
+        for (int code = 0; code < dictionary.size(); ++code) {
+            if (dictionary.value(code).compare(value, cs) == 0) {
+                rows = rows | index.rows(code);
+            }
+        }
+        break;
+    }
+    case SeasonIndex:
+    case MedalIndex: {
+        const AthleteTable::Flag mask = column == SeasonIndex ? AthleteTable::SeasonMask : AthleteTable::MedalMask;
+        const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+        for (int state = 0; state < 4; ++state) {
+            const quint8 bits = static_cast<quint8>(state << shift);
+            if (column == SeasonIndex && bits == AthleteTable::OtherSeason) {
+                // Seasons outside Summer and Winter share this posting list, so each row is checked
+                RowBitmap matching;
+                for (int row : index.rows(bits).rows()) {
+                    if (table.season(row).compare(value, cs) == 0) {
+                        matching.add(row);
+                    }
+                }
+                rows = rows | matching;
+            } else if (AthleteTable::flagText(bits, mask).compare(value, cs) == 0) {
+                rows = rows | index.rows(bits);
+            }
+        }
+        break;
+    }
+    case YearIndex: {
+        bool ok = false;
+        const int year = value.toInt(&ok);
+        if (ok && QString::number(year) == value) {
+            rows = index.rows(static_cast<quint32>(year));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return rows;
+}
+
+const DataBase::SortIndex& DataBase::sortIndex(AthleteTable::Field field) const {
+    if (sortIndexes.isEmpty()) {
+        sortIndexes.resize(AthleteTable::FieldCount);
+    }
+
+    SortIndex& index = sortIndexes[field];
+    if (index.order.size() == table.size()) {
+        return index;
+    }
+
+    // Key above row, so a plain sort of the pairs is stable by row
+    const QVector<quint32> keys = table.sortKeys(field);
+    QVector<quint64> entries;
+    entries.reserve(keys.size());
+    for (int row = 0; row < keys.size(); ++row) {
+        entries.append((quint64(keys.at(row)) << 32) | quint32(row));
+    }
+    std::sort(entries.begin(), entries.end());
+
+    index.order.resize(entries.size());
+    index.ranks.resize(entries.size());
+    int rank = -1;
+    for (int position = 0; position < entries.size(); ++position) {
+        const quint64 entry = entries.at(position);
+        if (position == 0 || (entry >> 32) != (entries.at(position - 1) >> 32)) {
+            ++rank;
+        }
+        const int row = static_cast<int>(entry & 0xffffffffu);
+        index.order[position] = row;
+        index.ranks[row] = rank;
+    }
+    return index;
+}
+
+QVector<int> DataBase::sortedRows(const RowBitmap& selection, AthleteTable::Field field, Qt::SortOrder order) const {
+    const SortIndex& index = sortIndex(field);
+    const bool everyRow = selection.count() == index.order.size();
+    QVector<int> rows;
+    rows.reserve(selection.count());
+
+    if (order == Qt::AscendingOrder) {
+        for (int row : index.order) {
+            if (everyRow || selection.contains(row)) {
+                rows.append(row);
+            }
+        }
+        return rows;
+    }
+
+    int end = index.order.size();
+    while (end > 0) {
+        const int rank = index.ranks.at(index.order.at(end - 1));
+        int begin = end - 1;
+        while (begin > 0 && index.ranks.at(index.order.at(begin - 1)) == rank) {
+            --begin;
+        }
+        for (int position = begin; position < end; ++position) {
+            const int row = index.order.at(position);
+            if (everyRow || selection.contains(row)) {
+                rows.append(row);
+            }
+        }
+        end = begin;
+    }
+    return rows;
+}
+
+void DataBase::setStreaming(bool active) {
+    if (streaming == active) {
+        return;
+    }
+    streaming = active;
+    emit streamingChanged(streaming);
+}
+
+void DataBase::saveSnapshot(const QString& sourcePath, const DataSnapshot::SourceStamp& stamp,
+                            const DataSnapshot::Prefix& prefix) const {
+    const AthleteTable rows = table;
+    QThreadPool::globalInstance()->start([sourcePath, rows, stamp, prefix]() {
+        DataSnapshot::save(sourcePath, rows, stamp, prefix);
+    });
+}
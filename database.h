@@ -6,39 +6,96 @@
 #include <QString>
 #include <QDir>
 
-struct Athlete {
-    int id;
-    QString name;
-    QString sex;
-    float age;
-    float height;
-    float weight;
-    QString team;
-    QString noc;
-    QString games;
-    int year;
-    QString season;
-    QString city;
-    QString sport;
-    QString event;
-    QString medal;
-};
+#include "athletetable.h"
+#include "datasnapshot.h"
+#include "postingindex.h"
 
 class DataBase : public QObject {
     Q_OBJECT
 private:
-    QVector<Athlete> athletes;
+    AthleteTable table;
+    QVector<Athlete> pending;
+    int transactionDepth;
+    bool streaming;
     static DataBase* instance;
     DataBase(QObject *parent = nullptr);
+    void indexRows(int first);
 
 public:
     static DataBase* getInstance();
     void addAthlete(const Athlete& athlete);
     void clear();
-    const QVector<Athlete>& getAthletes() const { return athletes; }
+    const AthleteTable& getTable() const { return table; }
+    int rowCount() const { return table.size(); }
+    AthleteRow row(int index) const { return AthleteRow(table, index); }
+
+    // Rows added inside a transaction are staged and published together by commit(),
+    // which emits a single append notification for the whole range.
+    void reserve(int rows);
+    void beginTransaction();
+    void appendBatch(const QVector<Athlete>& batch);
+    int commit();
+    void rollback();
+
+    // Replaces every row with a finished table, such as one read from a
+    // snapshot, published as a single append.
+    void setTable(const AthleteTable& rows);
+
+    // Columns with posting lists, extended on every commit.
+    enum IndexedColumn {
+        NocIndex,
+        SportIndex,
+        SeasonIndex,
+        MedalIndex,
+        YearIndex,
+        IndexedColumnCount
+    };
+
+    // Rows whose displayed text in column equals value.
+    RowBitmap rowsEqualTo(IndexedColumn column, const QString& value,
+                             Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+
+    // Rows in ascending order of field, and each row's rank in that order with
+    // equal values sharing a rank. Built on first use and kept until rows change.
+    const QVector<int>& sortOrder(AthleteTable::Field field) const { return sortIndex(field).order; }
+    const QVector<int>& sortRanks(AthleteTable::Field field) const { return sortIndex(field).ranks; }
+
+    // The selected rows ordered by field, gathered from sortOrder() in one pass.
+    // Descending order walks it backwards but keeps equal values in row order.
+    QVector<int> sortedRows(const RowBitmap& selection, AthleteTable::Field field, Qt::SortOrder order) const;
+
+    // Writes a binary snapshot of the current rows next to sourcePath on a
+    // background thread; the copy shares column storage with the live table.
+    // stamp describes the source the rows were parsed from.
+    void saveSnapshot(const QString& sourcePath, const DataSnapshot::SourceStamp& stamp,
+                      const DataSnapshot::Prefix& prefix) const;
+
+    // Names can stay in the mapped CSV they were loaded from; detachText()
+    // copies them into memory before the file is reparsed or rewritten.
+    bool hasMappedText() const { return table.hasMappedText(); }
+    void detachText() { table.detachText(); }
+
+    // True while a load is still committing batches, so views can expose rows progressively.
+    void setStreaming(bool active);
+    bool isStreaming() const { return streaming; }
+
+private:
+    struct SortIndex {
+        QVector<int> order;
+        QVector<int> ranks;
+    };
+    const SortIndex& sortIndex(AthleteTable::Field field) const;
+
+    PostingIndex indexes[IndexedColumnCount];
+    mutable QVector<SortIndex> sortIndexes;
 
 signals:
+    void aboutToBeCleared();
+    void cleared();
+    void rowsAboutToBeAppended(int first, int last);
+    void rowsAppended(int first, int last);
     void dataChanged();
+    void streamingChanged(bool active);
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,392 @@
+#include "datasnapshot.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstring>
+
+namespace {
+
+const char Magic[8] = {'O', 'L', 'Y', 'S', 'N', 'A', 'P', '\0'};
+const quint32 ByteOrderMark = 0x01020304;
+const qint64 HashSampleBytes = 64 * 1024;
+const int HashBytes = 16;
+
+enum ColumnKind : quint32 {
+    Int32Column = 1,
+    Float32Column = 2,
+    StringColumn = 3
+};
+
+typedef AthleteTable::StoredColumns StoredColumns;
+typedef AthleteTable::StoredDictionary StoredDictionary;
+
+QVector<int> StoredColumns::* const IntColumns[] = {
+    &StoredColumns::ids, &StoredColumns::years
+};
+
+QVector<float> StoredColumns::* const FloatColumns[] = {
+    &StoredColumns::ages, &StoredColumns::heights, &StoredColumns::weights
+};
+
+// Name is stored first, ahead of these
+StoredDictionary StoredColumns::* const StringColumns[] = {
+    &StoredColumns::sexes, &StoredColumns::teams, &StoredColumns::nocs, &StoredColumns::games,
+    &StoredColumns::seasons, &StoredColumns::cities, &StoredColumns::sports, &StoredColumns::events,
+    &StoredColumns::medals
+};
+
+const quint32 ColumnCount = sizeof(IntColumns) / sizeof(IntColumns[0])
+                          + sizeof(FloatColumns) / sizeof(FloatColumns[0])
+                          + 1 + sizeof(StringColumns) / sizeof(StringColumns[0]);
+
+template <typename T>
+void appendValue(QByteArray& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void alignTo8(QByteArray& out) {
+    while (out.size() % 8 != 0) {
+        out.append('\0');
+    }
+}
+
+template <typename T, typename Value>
+void writeNumericColumn(QByteArray& out, ColumnKind kind, const QVector<Value>& column) {
+    appendValue(out, static_cast<quint32>(kind));
+    appendValue(out, static_cast<quint32>(column.size()));
+    for (const Value& value : column) {
+        appendValue(out, static_cast<T>(value));
+    }
+    alignTo8(out);
+}
+
+void writeDictionaryColumn(QByteArray& out, const QVector<QString>& values, const QVector<quint32>& rowCodes) {
+    QByteArray text;
+    QVector<quint32> offsets;
+    offsets.reserve(values.size() + 1);
+    offsets.append(0);
+    for (const QString& value : values) {
+        text.append(value.toUtf8());
+        offsets.append(static_cast<quint32>(text.size()));
+    }
+
+    appendValue(out, static_cast<quint32>(StringColumn));
+    appendValue(out, static_cast<quint32>(values.size()));
+    out.append(reinterpret_cast<const char*>(offsets.constData()), offsets.size() * sizeof(quint32));
+    alignTo8(out);
+    out.append(text);
+    alignTo8(out);
+    out.append(reinterpret_cast<const char*>(rowCodes.constData()), rowCodes.size() * sizeof(quint32));
+    alignTo8(out);
+}
+
+void writeDictionaryColumn(QByteArray& out, const DictionaryColumn& column) {
+    writeDictionaryColumn(out, column.dictionary().values(), column.codes());
+}
+
+// Packed fields are written as four-entry dictionaries indexed by their bits,
+// extended with the texts of their third state. With athleteIndexes, flags
+// are per athlete and spread over the rows.
+void writeFlagColumn(QByteArray& out, const QVector<quint8>& flags, AthleteTable::Flag mask,
+                     const QHash<int, QString>& others, const QVector<quint32>* athleteIndexes = nullptr) {
+    const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+    QVector<QString> values;
+    for (int state = 0; state < 4; ++state) {
+        values.append(AthleteTable::flagText(static_cast<quint8>(state << shift), mask));
+    }
+    QHash<QString, quint32> codeByText;
+    QHash<int, quint32> otherCodes;
+    for (auto it = others.constBegin(); it != others.constEnd(); ++it) {
+        auto code = codeByText.constFind(it.value());
+        if (code == codeByText.constEnd()) {
+            code = codeByText.insert(it.value(), static_cast<quint32>(values.size()));
+            values.append(it.value());
+        }
+        otherCodes.insert(it.key(), code.value());
+    }
+
+    const int rows = athleteIndexes ? athleteIndexes->size() : flags.size();
+    QVector<quint32> rowCodes;
+    rowCodes.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        const int index = athleteIndexes ? static_cast<int>(athleteIndexes->at(row)) : row;
+        const quint32 state = (flags.at(index) & mask) >> shift;
+        rowCodes.append(state == 3 ? otherCodes.value(index, state) : state);
+    }
+    writeDictionaryColumn(out, values, rowCodes);
+}
+
+template <typename Column>
+void writeMeasurementColumn(QByteArray& out, const Column& column) {
+    appendValue(out, static_cast<quint32>(Float32Column));
+    appendValue(out, static_cast<quint32>(column.size()));
+    for (int row = 0; row < column.size(); ++row) {
+        appendValue(out, column.at(row));
+    }
+    alignTo8(out);
+}
+
+// Athlete attributes are stored once per athlete; the file has one value per row
+template <typename T>
+QVector<T> perRow(const QVector<T>& values, const QVector<quint32>& athleteIndexes) {
+    QVector<T> rows;
+    rows.reserve(athleteIndexes.size());
+    for (quint32 index : athleteIndexes) {
+        rows.append(values.at(index));
+    }
+    return rows;
+}
+
+// Names are already unique per athlete, so they form the dictionary as they
+// are and each row's athlete index is its code.
+void writeTextColumn(QByteArray& out, const TextColumn& column, const QVector<quint32>& rowCodes) {
+    QByteArray text;
+    QVector<quint32> offsets;
+    offsets.reserve(column.size() + 1);
+    offsets.append(0);
+    for (int row = 0; row < column.size(); ++row) {
+        text.append(column.utf8(row));
+        offsets.append(static_cast<quint32>(text.size()));
+    }
+
+    appendValue(out, static_cast<quint32>(StringColumn));
+    appendValue(out, static_cast<quint32>(column.size()));
+    out.append(reinterpret_cast<const char*>(offsets.constData()), offsets.size() * sizeof(quint32));
+    alignTo8(out);
+    out.append(text);
+    alignTo8(out);
+    out.append(reinterpret_cast<const char*>(rowCodes.constData()), rowCodes.size() * sizeof(quint32));
+    alignTo8(out);
+}
+
+// Bounds-checked cursor over the mapped snapshot.
+class Reader {
+public:
+    Reader(const char* begin, const char* end) : pos(begin), end(end) {}
+
+    template <typename T>
+    const T* take(qint64 count) {
+        const qint64 bytes = count * static_cast<qint64>(sizeof(T));
+        if (count < 0 || bytes > end - pos) {
+            return nullptr;
+        }
+        const T* data = reinterpret_cast<const T*>(pos);
+        pos += bytes;
+        return data;
+    }
+
+    bool align() {
+        const qint64 padding = (8 - (reinterpret_cast<quintptr>(pos) % 8)) % 8;
+        return take<char>(padding) != nullptr;
+    }
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+template <typename T>
+bool readNumericColumn(Reader& reader, ColumnKind kind, int rows, QVector<T>& column) {
+    const quint32* header = reader.take<quint32>(2);
+    if (!header || header[0] != static_cast<quint32>(kind) || header[1] != static_cast<quint32>(rows)) {
+        return false;
+    }
+    const T* values = reader.take<T>(rows);
+    if (!values || !reader.align()) {
+        return false;
+    }
+    column = QVector<T>(values, values + rows);
+    return true;
+}
+
+template <typename Text>
+Text textValue(const char* utf8, int size);
+
+template <>
+QString textValue<QString>(const char* utf8, int size) {
+    return QString::fromUtf8(utf8, size);
+}
+
+template <>
+QByteArray textValue<QByteArray>(const char* utf8, int size) {
+    return QByteArray(utf8, size);
+}
+
+template <typename Text>
+bool readDictionaryColumn(Reader& reader, int rows, QVector<Text>& values, QVector<quint32>& rowCodes) {
+    const quint32* header = reader.take<quint32>(2);
+    if (!header || header[0] != StringColumn) {
+        return false;
+    }
+    const quint32 dictionarySize = header[1];
+    const quint32* offsets = reader.take<quint32>(qint64(dictionarySize) + 1);
+    if (!offsets || !reader.align()) {
+        return false;
+    }
+    const char* text = reader.take<char>(offsets[dictionarySize]);
+    if (!text || !reader.align()) {
+        return false;
+    }
+
+    values.clear();
+    values.reserve(dictionarySize);
+    for (quint32 i = 0; i < dictionarySize; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            return false;
+        }
+        values.append(textValue<Text>(text + offsets[i], offsets[i + 1] - offsets[i]));
+    }
+
+    // Codes are range-checked by AthleteTable::assign()
+    const quint32* codes = reader.take<quint32>(rows);
+    if (!codes || !reader.align()) {
+        return false;
+    }
+    rowCodes = QVector<quint32>(codes, codes + rows);
+    return true;
+}
+
+}
+
+QString DataSnapshot::pathFor(const QString& sourcePath) {
+    return sourcePath + ".snapshot";
+}
+
+bool DataSnapshot::stampSource(const QString& sourcePath, SourceStamp& stamp) {
+    QFile source(sourcePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    stamp.size = source.size();
+    stamp.modified = QFileInfo(source).lastModified().toMSecsSinceEpoch();
+
+    // Hashing the head and tail keeps validation cheap on large files; size and
+    // mtime catch the edits that leave both untouched.
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(source.read(HashSampleBytes));
+    if (stamp.size > HashSampleBytes) {
+        source.seek(qMax(HashSampleBytes, stamp.size - HashSampleBytes));
+        hash.addData(source.readAll());
+    }
+    stamp.hash = hash.result();
+    return stamp.hash.size() == HashBytes;
+}
+
+bool DataSnapshot::save(const QString& sourcePath, const AthleteTable& athletes, const SourceStamp& stamp,
+                        const Prefix& prefix) {
+    SourceStamp current;
+    if (stamp.hash.size() != HashBytes || !stampSource(sourcePath, current) || !(current == stamp)) {
+        qDebug() << "Source changed since it was parsed, not saving a snapshot:" << sourcePath;
+        return false;
+    }
+
+    QByteArray out;
+    out.append(Magic, sizeof(Magic));
+    appendValue(out, static_cast<quint32>(Version));
+    appendValue(out, ByteOrderMark);
+    appendValue(out, static_cast<quint32>(athletes.size()));
+    appendValue(out, ColumnCount);
+    appendValue(out, stamp.size);
+    appendValue(out, stamp.modified);
+    out.append(stamp.hash);
+    appendValue(out, prefix.bytes);
+    appendValue(out, static_cast<qint64>(prefix.unterminatedTail));
+    out.append(prefix.checksum.leftJustified(HashBytes, '\0', true));
+
+    // Same order as IntColumns, FloatColumns and StringColumns
+    const AthleteDimension& dimension = athletes.athletes();
+    writeNumericColumn<qint32>(out, Int32Column, perRow(dimension.ids(), athletes.athleteIndexes()));
+    writeNumericColumn<qint32>(out, Int32Column, athletes.years());
+    writeMeasurementColumn(out, athletes.ages());
+    writeMeasurementColumn(out, athletes.heights());
+    writeMeasurementColumn(out, athletes.weights());
+    writeTextColumn(out, dimension.names(), athletes.athleteIndexes());
+    writeFlagColumn(out, dimension.sexes(), AthleteTable::SexMask, dimension.otherSexes(), &athletes.athleteIndexes());
+    writeDictionaryColumn(out, athletes.teams());
+    writeDictionaryColumn(out, athletes.nocs());
+    writeDictionaryColumn(out, athletes.games());
+    writeFlagColumn(out, athletes.flags(), AthleteTable::SeasonMask, athletes.otherSeasons());
+    writeDictionaryColumn(out, athletes.cities());
+    writeDictionaryColumn(out, athletes.sports());
+    writeDictionaryColumn(out, athletes.events());
+    writeFlagColumn(out, athletes.flags(), AthleteTable::MedalMask, QHash<int, QString>());
+
+    QSaveFile file(pathFor(sourcePath));
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size()) {
+        qDebug() << "Failed to write snapshot:" << file.fileName();
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool DataSnapshot::load(const QString& sourcePath, AthleteTable& athletes, Prefix& prefix) {
+    QFile file(pathFor(sourcePath));
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 size = file.size();
+    uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+    if (!mapped) {
+        return false;
+    }
+
+    const char* begin = reinterpret_cast<const char*>(mapped);
+    Reader reader(begin, begin + size);
+
+    const char* magic = reader.take<char>(sizeof(Magic));
+    const quint32* header = reader.take<quint32>(4);
+    const qint64* source = reader.take<qint64>(2);
+    const char* hash = reader.take<char>(HashBytes);
+    const qint64* ingested = reader.take<qint64>(2);
+    const char* ingestedChecksum = reader.take<char>(HashBytes);
+
+    SourceStamp stamp;
+    const bool valid = magic && header && source && hash && ingested && ingestedChecksum
+            && std::memcmp(magic, Magic, sizeof(Magic)) == 0
+            && header[0] == static_cast<quint32>(Version) && header[1] == ByteOrderMark && header[3] == ColumnCount
+            && qint64(header[2]) * ColumnCount * sizeof(quint32) <= size
+            && stampSource(sourcePath, stamp)
+            && source[0] == stamp.size && source[1] == stamp.modified
+            && std::memcmp(hash, stamp.hash.constData(), HashBytes) == 0;
+    if (!valid) {
+        qDebug() << "Snapshot is stale or incompatible:" << file.fileName();
+        file.unmap(mapped);
+        return false;
+    }
+
+    const int rows = static_cast<int>(header[2]);
+    StoredColumns columns;
+    bool ok = true;
+    for (QVector<int> StoredColumns::* member : IntColumns) {
+        ok = ok && readNumericColumn(reader, Int32Column, rows, columns.*member);
+    }
+    for (QVector<float> StoredColumns::* member : FloatColumns) {
+        ok = ok && readNumericColumn(reader, Float32Column, rows, columns.*member);
+    }
+    ok = ok && readDictionaryColumn(reader, rows, columns.names, columns.nameCodes);
+    for (StoredDictionary StoredColumns::* member : StringColumns) {
+        ok = ok && readDictionaryColumn(reader, rows, (columns.*member).values, (columns.*member).codes);
+    }
+    file.unmap(mapped);
+
+    // The dictionaries and codes go into the table as they are, without rebuilding rows
+    AthleteTable table;
+    if (!ok || !table.assign(columns)) {
+        qDebug() << "Snapshot is corrupt:" << file.fileName();
+        return false;
+    }
+
+    athletes = table;
+    prefix.bytes = ingested[0];
+    prefix.unterminatedTail = ingested[1] != 0;
+    prefix.checksum = prefix.bytes > 0 ? QByteArray(ingestedChecksum, HashBytes) : QByteArray();
+    return true;
+}
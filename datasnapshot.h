@@ -0,0 +1,56 @@
+#ifndef DATASNAPSHOT_H
+#define DATASNAPSHOT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "athletetable.h"
+
+// Binary columnar copy of a parsed dataset, stored next to the source CSV.
+// Numeric columns are raw arrays and text columns are a string dictionary
+// plus one code per row, so a warm start is a mapping rather than a parse.
+class DataSnapshot {
+public:
+    static constexpr quint32 Version = 4;
+
+    static QString pathFor(const QString& sourcePath);
+
+    // Identifies one version of a source file: size, mtime and a hash of its
+    // head and tail.
+    struct SourceStamp {
+        qint64 size = 0;
+        qint64 modified = 0;
+        QByteArray hash;
+
+        bool operator==(const SourceStamp& other) const {
+            return size == other.size && modified == other.modified && hash == other.hash;
+        }
+    };
+
+    // The part of a plain source that became rows, so a reload can parse only
+    // what was appended after it. It ends after the last line break parsed.
+    struct Prefix {
+        qint64 bytes = 0;
+        QByteArray checksum;
+        // A final record without a line break was parsed too; it may still be
+        // growing, so the next reload parses the whole file instead of appending
+        bool unterminatedTail = false;
+    };
+
+    // Loaders stamp the source before parsing it, so the stamp describes the
+    // bytes the rows came from.
+    static bool stampSource(const QString& sourcePath, SourceStamp& stamp);
+
+    // Refuses to save when the source no longer matches stamp, since a
+    // snapshot of older rows would otherwise pass as current. prefix is stored
+    // with the rows and handed back by load().
+    static bool save(const QString& sourcePath, const AthleteTable& athletes, const SourceStamp& stamp,
+                     const Prefix& prefix);
+
+    // Fails when the snapshot is missing, stale (source size, mtime or sampled
+    // hash changed), from another format version, or structurally corrupt.
+    static bool load(const QString& sourcePath, AthleteTable& athletes, Prefix& prefix);
+};
+
+#endif // DATASNAPSHOT_H
@@ -0,0 +1,522 @@
+#include "filterexpression.h"
+
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVector>
+
+#include <cmath>
+
+struct FilterExpression::Node {
+    enum Kind { AndNode, OrNode, NotNode, CompareNode };
+    enum Operator { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Between, In, Match };
+    // Patterns without metacharacters are matched as text, skipping the regex engine
+    enum MatchKind { RegexMatch, ContainsMatch, PrefixMatch, SuffixMatch, ExactMatch };
+
+    Kind kind = CompareNode;
+    std::shared_ptr<const Node> left;   // the operand of NotNode
+    std::shared_ptr<const Node> right;
+
+    AthleteTable::Field field = AthleteTable::IdField;
+    Operator op = Equal;
+    QStringList values;
+    QVector<double> numbers;  // values parsed once, for numeric fields
+    MatchKind matchKind = RegexMatch;
+    QString literal;
+    QRegularExpression pattern;
+};
+
+namespace {
+
+typedef FilterExpression::Node Node;
+typedef std::shared_ptr<const Node> NodePtr;
+
+// Column names as the table view shows them, in AthleteTable::Field order
+const char* const FieldNames[] = {
+    "ID", "Name", "Sex", "Age", "Height", "Weight", "Team", "NOC",
+    "Games", "Year", "Season", "City", "Sport", "Event", "Medal"
+};
+
+bool isNumeric(AthleteTable::Field field) {
+    switch (field) {
+    case AthleteTable::IdField:
+    case AthleteTable::AgeField:
+    case AthleteTable::HeightField:
+    case AthleteTable::WeightField:
+    case AthleteTable::YearField:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct Token {
+    enum Type { Word, Quoted, Symbol, End };
+
+    Type type;
+    QString text;
+};
+
+bool tokenize(const QString& text, QVector<Token>& tokens) {
+    static const QString symbols = QStringLiteral("(),=!<>~");
+    static const QStringList pairs = {"<=", ">=", "!=", "<>", "=="};
+
+    int i = 0;
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == '"' || c == '\'') {
+            // Quotes only open a value at its start, so "Men's" stays one word
+            const int close = text.indexOf(c, i + 1);
+            if (close < 0) {
+                return false;
+            }
+            tokens.append({Token::Quoted, text.mid(i + 1, close - i - 1)});
+            i = close + 1;
+        } else if (symbols.contains(c)) {
+            const QString pair = text.mid(i, 2);
+            const QString symbol = pairs.contains(pair) ? pair : QString(c);
+            tokens.append({Token::Symbol, symbol});
+            i += symbol.size();
+        } else {
+            int end = i;
+            while (end < text.size() && !text.at(end).isSpace() && !symbols.contains(text.at(end))) {
+                ++end;
+            }
+            tokens.append({Token::Word, text.mid(i, end - i)});
+            i = end;
+        }
+    }
+    tokens.append({Token::End, QString()});
+    return true;
+}
+
+bool operatorFor(const QString& symbol, Node::Operator& op) {
+    if (symbol == "=" || symbol == "==") op = Node::Equal;
+    else if (symbol == "!=" || symbol == "<>") op = Node::NotEqual;
+    else if (symbol == "<") op = Node::Less;
+    else if (symbol == "<=") op = Node::LessEqual;
+    else if (symbol == ">") op = Node::Greater;
+    else if (symbol == ">=") op = Node::GreaterEqual;
+    else if (symbol == "~") op = Node::Match;
+    else return false;
+    return true;
+}
+
+void compileMatch(Node& node, const QString& pattern) {
+    node.op = Node::Match;
+    bool atStart = false;
+    bool atEnd = false;
+    if (!FilterExpression::parseLiteral(pattern, node.literal, atStart, atEnd)) {
+        node.matchKind = Node::RegexMatch;
+        node.pattern = QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
+    } else if (atStart) {
+        node.matchKind = atEnd ? Node::ExactMatch : Node::PrefixMatch;
+    } else {
+        node.matchKind = atEnd ? Node::SuffixMatch : Node::ContainsMatch;
+    }
+}
+
+NodePtr combine(Node::Kind kind, const NodePtr& left, const NodePtr& right) {
+    if (!left || (kind != Node::NotNode && !right)) {
+        return nullptr;
+    }
+    auto node = std::make_shared<Node>();
+    node->kind = kind;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+// Recursive descent over: or := and (OR and)*, and := not (AND not)*,
+// not := NOT not | '(' or ')' | [column] [NOT] comparison
+class Parser {
+public:
+    Parser(const QVector<Token>& tokens, AthleteTable::Field defaultField)
+        : tokens(tokens), position(0), defaultField(defaultField) {}
+
+    NodePtr parse() {
+        NodePtr node = parseOr();
+        return peek().type == Token::End ? node : nullptr;
+    }
+
+private:
+    const Token& peek(int ahead = 0) const { return tokens.at(qMin(position + ahead, tokens.size() - 1)); }
+
+    static bool isKeyword(const Token& token, const char* keyword) {
+        return token.type == Token::Word && token.text.compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+    }
+
+    bool acceptKeyword(const char* keyword) {
+        if (!isKeyword(peek(), keyword)) {
+            return false;
+        }
+        ++position;
+        return true;
+    }
+
+    bool acceptSymbol(const char* symbol) {
+        if (peek().type != Token::Symbol || peek().text != QLatin1String(symbol)) {
+            return false;
+        }
+        ++position;
+        return true;
+    }
+
+    static bool startsComparison(const Token& token) {
+        Node::Operator op;
+        return (token.type == Token::Symbol && operatorFor(token.text, op))
+            || isKeyword(token, "between") || isKeyword(token, "in") || isKeyword(token, "not");
+    }
+
+    NodePtr parseOr() {
+        NodePtr node = parseAnd();
+        while (node && acceptKeyword("or")) {
+            node = combine(Node::OrNode, node, parseAnd());
+        }
+        return node;
+    }
+
+    NodePtr parseAnd() {
+        NodePtr node = parseNot();
+        while (node && acceptKeyword("and")) {
+            node = combine(Node::AndNode, node, parseNot());
+        }
+        return node;
+    }
+
+    NodePtr parseNot() {
+        if (acceptKeyword("not")) {
+            return combine(Node::NotNode, parseNot(), nullptr);
+        }
+        if (acceptSymbol("(")) {
+            NodePtr node = parseOr();
+            return acceptSymbol(")") ? node : nullptr;
+        }
+
+        AthleteTable::Field field = defaultField;
+        for (int named = 0; named < AthleteTable::FieldCount; ++named) {
+            if (isKeyword(peek(), FieldNames[named]) && startsComparison(peek(1))) {
+                field = static_cast<AthleteTable::Field>(named);
+                ++position;
+                break;
+            }
+        }
+        if (acceptKeyword("not")) {
+            return combine(Node::NotNode, parseComparison(field), nullptr);
+        }
+        return parseComparison(field);
+    }
+
+    NodePtr parseComparison(AthleteTable::Field field) {
+        auto node = std::make_shared<Node>();
+        node->field = field;
+
+        if (acceptKeyword("between")) {
+            node->op = Node::Between;
+            if (!parseValue(node->values) || !acceptKeyword("and") || !parseValue(node->values)) {
+                return nullptr;
+            }
+        } else if (acceptKeyword("in")) {
+            node->op = Node::In;
+            if (!acceptSymbol("(")) {
+                return nullptr;
+            }
+            do {
+                if (!parseValue(node->values)) {
+                    return nullptr;
+                }
+            } while (acceptSymbol(","));
+            if (!acceptSymbol(")")) {
+                return nullptr;
+            }
+        } else {
+            if (peek().type != Token::Symbol || !operatorFor(peek().text, node->op)) {
+                return nullptr;
+            }
+            ++position;
+            if (!parseValue(node->values)) {
+                return nullptr;
+            }
+        }
+
+        if (node->op == Node::Match) {
+            compileMatch(*node, node->values.first());
+            return node->matchKind != Node::RegexMatch || node->pattern.isValid() ? node : nullptr;
+        }
+        if (isNumeric(field)) {
+            for (const QString& value : node->values) {
+                bool ok = false;
+                node->numbers.append(value.toDouble(&ok));
+                if (!ok) {
+                    return nullptr;
+                }
+            }
+        }
+        return node;
+    }
+
+    // A quoted value, or unquoted words up to the next AND or OR
+    bool parseValue(QStringList& values) {
+        if (peek().type == Token::Quoted) {
+            values.append(tokens.at(position++).text);
+            return true;
+        }
+
+        QStringList words;
+        while (peek().type == Token::Word && !isKeyword(peek(), "and") && !isKeyword(peek(), "or")) {
+            words.append(tokens.at(position++).text);
+        }
+        if (words.isEmpty()) {
+            return false;
+        }
+        values.append(words.join(' '));
+        return true;
+    }
+
+    const QVector<Token>& tokens;
+    int position;
+    AthleteTable::Field defaultField;
+};
+
+bool matchesPattern(const Node& node, const QString& text) {
+    switch (node.matchKind) {
+    case Node::ContainsMatch: return text.contains(node.literal, Qt::CaseInsensitive);
+    case Node::PrefixMatch: return text.startsWith(node.literal, Qt::CaseInsensitive);
+    case Node::SuffixMatch: return text.endsWith(node.literal, Qt::CaseInsensitive);
+    case Node::ExactMatch: return text.compare(node.literal, Qt::CaseInsensitive) == 0;
+    default: return text.contains(node.pattern);
+    }
+}
+
+bool matchesText(const Node& node, const QString& text) {
+    auto compareTo = [&text](const QString& value) { return text.compare(value, Qt::CaseInsensitive); };
+
+    switch (node.op) {
+    case Node::Equal: return compareTo(node.values.at(0)) == 0;
+    case Node::NotEqual: return compareTo(node.values.at(0)) != 0;
+    case Node::Less: return compareTo(node.values.at(0)) < 0;
+    case Node::LessEqual: return compareTo(node.values.at(0)) <= 0;
+    case Node::Greater: return compareTo(node.values.at(0)) > 0;
+    case Node::GreaterEqual: return compareTo(node.values.at(0)) >= 0;
+    case Node::Between: return compareTo(node.values.at(0)) >= 0 && compareTo(node.values.at(1)) <= 0;
+    case Node::In:
+        for (const QString& value : node.values) {
+            if (compareTo(value) == 0) {
+                return true;
+            }
+        }
+        return false;
+    case Node::Match: return matchesPattern(node, text);
+    }
+    return false;
+}
+
+// Measurements are compared in their stored units, so "= 72.3" finds a stored 72.3
+bool matchesNumber(const Node& node, double value, int scale) {
+    if (node.op == Node::Match) {
+        return matchesPattern(node, QString::number(value / scale));
+    }
+
+    auto compareTo = [value, scale](double number) {
+        double threshold = number * scale;
+        const double nearest = std::round(threshold);
+        if (std::abs(threshold - nearest) < 1e-6) {
+            threshold = nearest;
+        }
+        return value < threshold ? -1 : (value > threshold ? 1 : 0);
+    };
+
+    switch (node.op) {
+    case Node::Equal: return compareTo(node.numbers.at(0)) == 0;
+    case Node::NotEqual: return compareTo(node.numbers.at(0)) != 0;
+    case Node::Less: return compareTo(node.numbers.at(0)) < 0;
+    case Node::LessEqual: return compareTo(node.numbers.at(0)) <= 0;
+    case Node::Greater: return compareTo(node.numbers.at(0)) > 0;
+    case Node::GreaterEqual: return compareTo(node.numbers.at(0)) >= 0;
+    case Node::Between: return compareTo(node.numbers.at(0)) >= 0 && compareTo(node.numbers.at(1)) <= 0;
+    case Node::In:
+        for (double number : node.numbers) {
+            if (compareTo(number) == 0) {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+template <typename Test>
+RowBitmap scan(int first, int end, Test test) {
+    RowBitmap rows;
+    for (int row = first; row < end; ++row) {
+        if (test(row)) {
+            rows.add(row);
+        }
+    }
+    return rows;
+}
+
+template <typename Storage, int Scale>
+RowBitmap scanMeasurement(const Node& node, const MeasurementColumn<Storage, Scale>& column, int first, int end) {
+    // Null measurements fail every comparison, but display as empty text to a pattern
+    const bool nullMatches = node.op == Node::Match && matchesPattern(node, QString());
+    const QVector<Storage>& values = column.rawValues();
+    return scan(first, end, [&](int row) {
+        return column.isNull(row) ? nullMatches : matchesNumber(node, values.at(row), Scale);
+    });
+}
+
+RowBitmap scanFlags(const Node& node, const QVector<quint8>& flags, AthleteTable::Flag mask,
+                    const QHash<int, QString>& others, const QVector<quint32>* athleteIndexes, int first, int end) {
+    const int shift = qCountTrailingZeroBits(static_cast<quint32>(mask));
+    bool accepted[4];
+    for (int state = 0; state < 4; ++state) {
+        accepted[state] = matchesText(node, AthleteTable::flagText(static_cast<quint8>(state << shift), mask));
+    }
+    // The third state of season and sex holds rare values of their own, tested one by one
+    QHash<int, bool> otherAccepted;
+    for (auto it = others.constBegin(); it != others.constEnd(); ++it) {
+        otherAccepted.insert(it.key(), matchesText(node, it.value()));
+    }
+    return scan(first, end, [&](int row) {
+        const int index = athleteIndexes ? static_cast<int>(athleteIndexes->at(row)) : row;
+        const int state = (flags.at(index) & mask) >> shift;
+        return state == 3 && mask != AthleteTable::MedalMask ? otherAccepted.value(index) : accepted[state];
+    });
+}
+
+RowBitmap scanDictionary(const Node& node, const DictionaryColumn& column, int first, int end) {
+    // Each distinct value is tested once; rows only look up their code
+    const StringDictionary& dictionary = column.dictionary();
+    QVector<char> accepted(dictionary.size());
+    for (int code = 0; code < dictionary.size(); ++code) {
+        accepted[code] = matchesText(node, dictionary.value(code));
+    }
+    const QVector<quint32>& codes = column.codes();
+    return scan(first, end, [&](int row) { return accepted.at(codes.at(row)) != 0; });
+}
+
+RowBitmap compare(const Node& node, const AthleteTable& table, int first, int end) {
+    const QVector<quint32>& athleteIndexes = table.athleteIndexes();
+    const AthleteDimension& athletes = table.athletes();
+
+    switch (node.field) {
+    case AthleteTable::IdField:
+        return scan(first, end, [&](int row) {
+            return matchesNumber(node, athletes.ids().at(athleteIndexes.at(row)), 1);
+        });
+    case AthleteTable::NameField: {
+        // Names are decoded once per athlete, and only for athletes in the range
+        enum { Unknown, Rejected, Accepted };
+        QVector<char> state(athletes.size(), Unknown);
+        return scan(first, end, [&](int row) {
+            const quint32 index = athleteIndexes.at(row);
+            if (state.at(index) == Unknown) {
+                const QString name = QString::fromUtf8(athletes.names().utf8(index));
+                state[index] = matchesText(node, name) ? Accepted : Rejected;
+            }
+            return state.at(index) == Accepted;
+        });
+    }
+    case AthleteTable::SexField:
+        return scanFlags(node, athletes.sexes(), AthleteTable::SexMask, athletes.otherSexes(), &athleteIndexes,
+                         first, end);
+    case AthleteTable::AgeField: return scanMeasurement(node, table.ages(), first, end);
+    case AthleteTable::HeightField: return scanMeasurement(node, table.heights(), first, end);
+    case AthleteTable::WeightField: return scanMeasurement(node, table.weights(), first, end);
+    case AthleteTable::TeamField: return scanDictionary(node, table.teams(), first, end);
+    case AthleteTable::NocField: return scanDictionary(node, table.nocs(), first, end);
+    case AthleteTable::GamesField: return scanDictionary(node, table.games(), first, end);
+    case AthleteTable::YearField: {
+        const QVector<int>& years = table.years();
+        return scan(first, end, [&](int row) { return matchesNumber(node, years.at(row), 1); });
+    }
+    case AthleteTable::SeasonField:
+        return scanFlags(node, table.flags(), AthleteTable::SeasonMask, table.otherSeasons(), nullptr, first, end);
+    case AthleteTable::CityField: return scanDictionary(node, table.cities(), first, end);
+    case AthleteTable::SportField: return scanDictionary(node, table.sports(), first, end);
+    case AthleteTable::EventField: return scanDictionary(node, table.events(), first, end);
+    case AthleteTable::MedalField:
+        return scanFlags(node, table.flags(), AthleteTable::MedalMask, QHash<int, QString>(), nullptr, first, end);
+    default:
+        return RowBitmap();
+    }
+}
+
+RowBitmap evaluateNode(const Node& node, const AthleteTable& table, int first, int end) {
+    switch (node.kind) {
+    case Node::AndNode: {
+        const RowBitmap left = evaluateNode(*node.left, table, first, end);
+        return left.isEmpty() ? left : left & evaluateNode(*node.right, table, first, end);
+    }
+    case Node::OrNode:
+        return evaluateNode(*node.left, table, first, end) | evaluateNode(*node.right, table, first, end);
+    case Node::NotNode:
+        return RowBitmap::range(first, end) - evaluateNode(*node.left, table, first, end);
+    default:
+        return compare(node, table, first, end);
+    }
+}
+
+}
+
+FilterExpression FilterExpression::parse(const QString& text, AthleteTable::Field defaultField) {
+    FilterExpression expression;
+    QVector<Token> tokens;
+    if (tokenize(text, tokens)) {
+        expression.root = Parser(tokens, defaultField).parse();
+    }
+    return expression;
+}
+
+FilterExpression FilterExpression::match(AthleteTable::Field field, const QString& pattern) {
+    auto node = std::make_shared<Node>();
+    node->field = field;
+    node->values.append(pattern);
+    compileMatch(*node, pattern);
+
+    // An invalid pattern is kept and matches nothing, as a failed regex filter always has
+    FilterExpression expression;
+    expression.root = node;
+    return expression;
+}
+
+bool FilterExpression::parseLiteral(const QString& pattern, QString& literal, bool& atStart, bool& atEnd) {
+    static const QString special = QStringLiteral("\\^$.|?*+()[]{}");
+
+    int begin = 0;
+    int end = pattern.size();
+    atStart = pattern.startsWith('^');
+    if (atStart) {
+        ++begin;
+    }
+    atEnd = end > begin && pattern.endsWith('$');
+    if (atEnd) {
+        --end;
+    }
+
+    literal.clear();
+    for (int i = begin; i < end; ++i) {
+        QChar c = pattern.at(i);
+        if (c == '\\') {
+            // A trailing backslash escapes the anchor, and \d, \w and the like are classes
+            if (i + 1 == end || pattern.at(i + 1).isLetterOrNumber()) {
+                return false;
+            }
+            c = pattern.at(++i);
+        } else if (special.contains(c)) {
+            return false;
+        }
+        literal.append(c);
+    }
+    return true;
+}
+
+RowBitmap FilterExpression::evaluate(const AthleteTable& table, int first, int end) const {
+    if (!root) {
+        return RowBitmap();
+    }
+    return evaluateNode(*root, table, qMax(first, 0), qMin(end, table.size()));
+}
@@ -0,0 +1,41 @@
+#ifndef FILTEREXPRESSION_H
+#define FILTEREXPRESSION_H
+
+#include <QString>
+
+#include <memory>
+
+#include "athletetable.h"
+#include "rowbitmap.h"
+
+// A filter typed into a filter row, such as "Year >= 2000",
+// "between 20 and 25", "NOC in (USA, BRA) and not Medal = NA" or
+// "Event ~ relay". Comparisons may leave out the column, which then is the
+// filter row's own. Text compares case-insensitively and ~ is a regular
+// expression search. The text is parsed once into a tree whose leaves test
+// the table's columns directly: numbers by value, categories once per
+// distinct value.
+class FilterExpression {
+public:
+    // The result is invalid when text is not an expression.
+    static FilterExpression parse(const QString& text, AthleteTable::Field defaultField);
+    // A case-insensitive regular expression search on one column, like
+    // "column ~ pattern" but without quoting the pattern.
+    static FilterExpression match(AthleteTable::Field field, const QString& pattern);
+
+    // Reads a pattern that is plain text apart from escaped characters and
+    // optional ^ and $ anchors, which are reported separately.
+    static bool parseLiteral(const QString& pattern, QString& literal, bool& atStart, bool& atEnd);
+
+    bool isValid() const { return root != nullptr; }
+
+    // Rows first..end-1 of table that satisfy the expression.
+    RowBitmap evaluate(const AthleteTable& table, int first, int end) const;
+
+    struct Node;
+
+private:
+    std::shared_ptr<const Node> root;
+};
+
+#endif // FILTEREXPRESSION_H
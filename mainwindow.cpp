@@ -1,3 +1,6 @@
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
 #include <QMessageBox>
 
 #include "mainwindow.h"
@@ -6,6 +9,8 @@
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , controller(new Controller(this))
+    , tableView(nullptr)
+    , graphView(nullptr)
     , currentViewMode(TableMode)
 {
     centralWidget = new QWidget(this);
@@ -15,20 +20,41 @@ MainWindow::MainWindow(QWidget *parent)
 
     statusLabel = new QLabel("Loading data...", this);
     progressBar = new QProgressBar(this);
+    cancelLoadButton = new QPushButton("Cancel", this);
+
+    QHBoxLayout* progressLayout = new QHBoxLayout;
+    progressLayout->addWidget(progressBar);
+    progressLayout->addWidget(cancelLoadButton);
 
     mainLayout->addWidget(statusLabel);
-    mainLayout->addWidget(progressBar);
+    mainLayout->addLayout(progressLayout);
 
     progressBar->setVisible(true);
     setupMenu();
 
+    // The table exists from the start so rows show up while the file is still loading
+    tableView = new OlympicTableView(this);
+    mainLayout->addWidget(tableView);
+    switchView(TableMode);
+
+    connect(controller, &Controller::loadingStarted, this, &MainWindow::handleLoadingStarted);
+    connect(controller, &Controller::loadingCancelled, this, &MainWindow::handleLoadingCancelled);
     connect(controller, &Controller::dataLoaded, this, &MainWindow::handleDataLoaded);
     connect(controller, &Controller::progressUpdated, this, &MainWindow::updateProgress);
+    connect(cancelLoadButton, &QPushButton::clicked, controller, &Controller::cancelLoading);
 
     resize(2400, 1200);
 
-    // Load data automatically
-    QString filePath = QDir::currentPath() + "/datasets/athlete_events.csv";
+    // Load data automatically; parsing runs on a worker thread so the window paints right away.
+    // Archived copies of the dataset are picked up when the plain CSV is absent.
+    const QString basePath = QDir::currentPath() + "/datasets/athlete_events.csv";
+    QString filePath = basePath;
+    for (const QString& candidate : {basePath, basePath + ".gz", basePath + ".zst"}) {
+        if (QFileInfo::exists(candidate)) {
+            filePath = candidate;
+            break;
+        }
+    }
     controller->loadCSV(filePath);
 }
 
@@ -40,6 +66,25 @@ void MainWindow::setupMenu()
     menuBar = new QMenuBar(this);
     setMenuBar(menuBar);
 
+    fileMenu = menuBar->addMenu("Arquivo");
+
+    openFileAction = fileMenu->addAction("Abrir CSV...");
+    openPartitionsAction = fileMenu->addAction("Abrir Pasta de Partições...");
+    cancelLoadAction = fileMenu->addAction("Cancelar Carregamento");
+    cancelLoadAction->setEnabled(false);
+
+    fileMenu->addSeparator();
+    reloadAppendedAction = fileMenu->addAction("Carregar Novos Registros");
+    autoReloadAction = fileMenu->addAction("Recarregar Automaticamente");
+    autoReloadAction->setCheckable(true);
+    autoReloadAction->setChecked(controller->isAutoReloadEnabled());
+
+    connect(openFileAction, &QAction::triggered, this, &MainWindow::openFile);
+    connect(openPartitionsAction, &QAction::triggered, this, &MainWindow::openPartitionDirectory);
+    connect(cancelLoadAction, &QAction::triggered, controller, &Controller::cancelLoading);
+    connect(reloadAppendedAction, &QAction::triggered, controller, &Controller::reloadAppended);
+    connect(autoReloadAction, &QAction::toggled, controller, &Controller::setAutoReload);
+
     viewMenu = menuBar->addMenu("Modo de Visualização");
 
     tableViewAction = viewMenu->addAction("Tabela");
@@ -87,22 +132,70 @@ void MainWindow::setupMenu()
     connect(combinedReportAction, &QAction::triggered, this, &MainWindow::generateCombinedReport);
 }
 
+void MainWindow::openFile() {
+    QString filePath = QFileDialog::getOpenFileName(
+        this,
+        tr("Open Dataset"),
+        QDir::currentPath() + "/datasets",
+        tr("CSV Files (*.csv *.csv.gz *.csv.zst);;All Files (*)")
+        );
+
+    if (!filePath.isEmpty()) {
+        controller->loadCSV(filePath);
+    }
+}
+
+void MainWindow::openPartitionDirectory() {
+    QString directory = QFileDialog::getExistingDirectory(
+        this,
+        tr("Open Partitioned Dataset"),
+        QDir::currentPath() + "/datasets"
+        );
+
+    if (!directory.isEmpty()) {
+        controller->loadPartitioned(directory);
+    }
+}
+
+void MainWindow::handleLoadingStarted(const QString& filePath) {
+    statusLabel->setText(QString("Loading %1...").arg(QFileInfo(filePath).fileName()));
+    statusLabel->setVisible(true);
+    progressBar->setValue(0);
+    progressBar->setVisible(true);
+    cancelLoadButton->setVisible(true);
+    cancelLoadAction->setEnabled(true);
+}
+
+void MainWindow::handleLoadingCancelled() {
+    progressBar->setVisible(false);
+    cancelLoadButton->setVisible(false);
+    cancelLoadAction->setEnabled(false);
+
+    const int rows = DataBase::getInstance()->rowCount();
+    statusLabel->setText(QString("Loading cancelled; %1 rows loaded.").arg(rows));
+    statusLabel->setVisible(true);
+}
+
 void MainWindow::handleDataLoaded(bool success) {
     progressBar->setVisible(false);
+    cancelLoadButton->setVisible(false);
+    cancelLoadAction->setEnabled(false);
 
     if (success) {
         statusLabel->setVisible(false);  // Hide the label on success
 
-        tableView = new OlympicTableView(this);
-        mainLayout->addWidget(tableView);
-
-        graphView = new OlympicGraphView(this);
-        mainLayout->addWidget(graphView);
+        if (!graphView) {
+            graphView = new OlympicGraphView(this);
+            mainLayout->addWidget(graphView);
 
-        switchView(TableMode);
+            switchView(currentViewMode);
+        } else {
+            graphView->refreshData();
+        }
     } else {
         statusLabel->setText("Error loading data!");
-        qDebug() << "Failed to load the CSV file from datasets folder";
+        statusLabel->setVisible(true);
+        qDebug() << "Failed to load the CSV file";
     }
 }
 
@@ -113,24 +206,32 @@ void MainWindow::updateProgress(int progress) {
 void MainWindow::switchView(ViewMode mode) {
     currentViewMode = mode;
 
-    if (tableView && graphView) {
-        switch (mode) {
-            case TableMode:
-                tableView->setVisible(true);
-                graphView->setVisible(false);
-                tableViewAction->setChecked(true);
-                graphViewAction->setChecked(false);
-                graphModeMenu->setEnabled(false);
-                break;
-
-            case GraphMode:
-                tableView->setVisible(false);
-                graphView->setVisible(true);
-                tableViewAction->setChecked(false);
-                graphViewAction->setChecked(true);
-                graphModeMenu->setEnabled(true);
-                break;
-        }
+    // The graph is only built once a load completes; until then stay on the table
+    if (!graphView) {
+        currentViewMode = TableMode;
+        tableView->setVisible(true);
+        tableViewAction->setChecked(true);
+        graphViewAction->setChecked(false);
+        graphModeMenu->setEnabled(false);
+        return;
+    }
+
+    switch (mode) {
+        case TableMode:
+            tableView->setVisible(true);
+            graphView->setVisible(false);
+            tableViewAction->setChecked(true);
+            graphViewAction->setChecked(false);
+            graphModeMenu->setEnabled(false);
+            break;
+
+        case GraphMode:
+            tableView->setVisible(false);
+            graphView->setVisible(true);
+            tableViewAction->setChecked(false);
+            graphViewAction->setChecked(true);
+            graphModeMenu->setEnabled(true);
+            break;
     }
 }
 
@@ -5,6 +5,7 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QProgressBar>
+#include <QPushButton>
 #include <QDebug>
 #include <QMenuBar>
 #include <QMenu>
@@ -28,8 +29,12 @@ public:
     ~MainWindow();
 
 private slots:
+    void handleLoadingStarted(const QString& filePath);
+    void handleLoadingCancelled();
     void handleDataLoaded(bool success);
     void updateProgress(int progress);
+    void openFile();
+    void openPartitionDirectory();
     void switchView(ViewMode mode);
     void onGraphModeChanged(int mode);
     void generateCombinedReport();
@@ -43,12 +48,19 @@ private:
     QVBoxLayout* mainLayout;
     QLabel* statusLabel;
     QProgressBar* progressBar;
+    QPushButton* cancelLoadButton;
     OlympicTableView* tableView;
     OlympicGraphView* graphView;
 
     QMenuBar* menuBar;
+    QMenu* fileMenu;
     QMenu* viewMenu;
     QMenu* graphModeMenu;
+    QAction* openFileAction;
+    QAction* openPartitionsAction;
+    QAction* cancelLoadAction;
+    QAction* reloadAppendedAction;
+    QAction* autoReloadAction;
     QAction* tableViewAction;
     QAction* graphViewAction;
     QAction* medalEvolutionAction;
@@ -0,0 +1,46 @@
+#include "mappedsource.h"
+
+#include <QMutex>
+#include <QVector>
+
+namespace {
+
+QMutex registryMutex;
+QVector<std::weak_ptr<MappedSource>> registry(MappedSource::MaxSources + 1);
+
+}
+
+MappedSource::~MappedSource() {
+    if (mapped) {
+        file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(mapped)));
+    }
+}
+
+std::shared_ptr<MappedSource> MappedSource::open(const QString& filePath) {
+    std::shared_ptr<MappedSource> source(new MappedSource(filePath));
+    if (!source->file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    source->bytes = source->file.size();
+    uchar* address = source->bytes > 0 ? source->file.map(0, source->bytes) : nullptr;
+    if (!address) {
+        return nullptr;
+    }
+    source->mapped = reinterpret_cast<const char*>(address);
+
+    // Id 0 is reserved for "not in a source"
+    QMutexLocker locker(&registryMutex);
+    for (int id = 1; id <= MaxSources; ++id) {
+        if (registry.at(id).expired()) {
+            registry[id] = source;
+            source->sourceId = static_cast<quint8>(id);
+            return source;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<MappedSource> MappedSource::find(quint8 id) {
+    QMutexLocker locker(&registryMutex);
+    return id > 0 && id <= MaxSources ? registry.at(id).lock() : nullptr;
+}
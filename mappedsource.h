@@ -0,0 +1,35 @@
+#ifndef MAPPEDSOURCE_H
+#define MAPPEDSOURCE_H
+
+#include <QFile>
+#include <QString>
+
+#include <memory>
+
+// A read-only memory mapping of a source file that stored rows can point
+// into instead of copying their text. Every open source has a small id so a
+// row can name it in a few bits; find() resolves the id while the source lives.
+class MappedSource {
+public:
+    static constexpr int MaxSources = 127;
+
+    ~MappedSource();
+
+    // Returns nullptr when the file cannot be mapped or all ids are in use.
+    static std::shared_ptr<MappedSource> open(const QString& filePath);
+    static std::shared_ptr<MappedSource> find(quint8 id);
+
+    quint8 id() const { return sourceId; }
+    const char* data() const { return mapped; }
+    qint64 size() const { return bytes; }
+
+private:
+    MappedSource(const QString& filePath) : file(filePath), mapped(nullptr), bytes(0), sourceId(0) {}
+
+    QFile file;
+    const char* mapped;
+    qint64 bytes;
+    quint8 sourceId;
+};
+
+#endif // MAPPEDSOURCE_H
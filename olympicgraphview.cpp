@@ -10,12 +10,51 @@
 #include "exportmanager.h"
 #include "reportdialog.h"
 
+namespace {
+
+// Selects rows by season and medal with bit tests on the packed row flags.
+// "All" leaves the season open or accepts any of the three medals; an empty
+// medal type does not look at medals at all.
+class FlagFilter {
+public:
+    explicit FlagFilter(const QString& season, const QString& medalType = QString())
+        : mask(0), value(0), anyMedal(medalType == "All")
+    {
+        if (season != "All") {
+            mask |= AthleteTable::SeasonMask;
+            value |= AthleteTable::flagValue(season, AthleteTable::SeasonMask);
+        }
+        if (!medalType.isEmpty() && !anyMedal) {
+            mask |= AthleteTable::MedalMask;
+            value |= AthleteTable::flagValue(medalType, AthleteTable::MedalMask);
+        }
+    }
+
+    bool matches(quint8 flags) const {
+        return (flags & mask) == value && (!anyMedal || hasMedal(flags));
+    }
+
+    static bool hasMedal(quint8 flags) {
+        return (flags & AthleteTable::MedalMask) != 0;
+    }
+
+private:
+    quint8 mask;
+    quint8 value;
+    bool anyMedal;
+};
+
+}
+
 OlympicGraphView::OlympicGraphView(QWidget *parent)
     : QWidget(parent)
     , currentChartType(LineChart)
     , currentGraphMode(MedalEvolution)
     , db(DataBase::getInstance())
 {
+    connect(db, &DataBase::cleared, this, [this]() { medalCache.clear(); });
+    connect(db, &DataBase::rowsAppended, this, &OlympicGraphView::updateMedalCache);
+
     setupUI();
     populateCountryList();
     loadSettings();
@@ -72,8 +111,8 @@ void OlympicGraphView::populateCountryList()
 {
     QMap<QString, bool> normalizedCountries;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        normalizedCountries[normalizeCountryName(athlete.team)] = true;
+    for (const QString& country : db->getTable().countries().dictionary().values()) {
+        normalizedCountries[country] = true;
     }
 
     QStringList countryList = normalizedCountries.keys();
@@ -86,19 +125,6 @@ void OlympicGraphView::populateCountryList()
     }
 }
 
-QString OlympicGraphView::normalizeCountryName(const QString& rawName)
-{
-    static QRegularExpression pattern("-(\\d+)$");
-
-    QString normalizedName = rawName;
-    QRegularExpressionMatch match = pattern.match(normalizedName);
-    if (match.hasMatch()) {
-        normalizedName.truncate(match.capturedStart());
-    }
-
-    return normalizedName;
-}
-
 void OlympicGraphView::updateUI()
 {
     QLayoutItem *child;
@@ -149,6 +175,12 @@ void OlympicGraphView::setGraphMode(GraphMode mode)
     saveSettings();
 }
 
+void OlympicGraphView::refreshData()
+{
+    updateUI();
+    updateChart();
+}
+
 void OlympicGraphView::clearChartData()
 {
     chart->removeAllSeries();
@@ -272,11 +304,19 @@ QMap<int, int> OlympicGraphView::getMedalCountsByYear(const QString& normalizedC
 
     QMap<int, int> medalCounts;
 
+    const AthleteTable& table = db->getTable();
+    const QVector<quint32>& countries = table.countries().codes();
+    const QVector<quint8>& flags = table.flags();
+    const QVector<int>& athleteYears = table.years();
+
+    const quint32 country = table.countries().dictionary().find(normalizedCountry);
+    const FlagFilter seasonFilter(season);
+    const FlagFilter medalFilter(season, medalType);
+
     QSet<int> yearsSet;
-    for (const Athlete& athlete : db->getAthletes()) {
-        if ((season == "All" || athlete.season == season) &&
-            athlete.year > 0) {
-            yearsSet.insert(athlete.year);
+    for (int row = 0; row < table.size(); ++row) {
+        if (seasonFilter.matches(flags.at(row)) && athleteYears.at(row) > 0) {
+            yearsSet.insert(athleteYears.at(row));
         }
     }
 
@@ -287,23 +327,9 @@ QMap<int, int> OlympicGraphView::getMedalCountsByYear(const QString& normalizedC
         medalCounts[year] = 0;
     }
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        QString athleteCountry = normalizeCountryName(athlete.team);
-        if (athleteCountry != normalizedCountry) {
-            continue;
-        }
-
-        if (season != "All" && athlete.season != season) {
-            continue;
-        }
-
-        if (medalType == "All") {
-            if (!athlete.medal.isEmpty() && athlete.medal != "NA") {
-                medalCounts[athlete.year]++;
-            }
-        }
-        else if (athlete.medal == medalType) {
-            medalCounts[athlete.year]++;
+    for (int row = 0; row < table.size(); ++row) {
+        if (countries.at(row) == country && medalFilter.matches(flags.at(row))) {
+            medalCounts[athleteYears.at(row)]++;
         }
     }
 
@@ -312,13 +338,53 @@ QMap<int, int> OlympicGraphView::getMedalCountsByYear(const QString& normalizedC
     return medalCounts;
 }
 
+// Appended rows only touch the years they belong to, so cached series are
+// patched in place instead of being recomputed from the whole table.
+void OlympicGraphView::updateMedalCache(int first, int last)
+{
+    const AthleteTable& table = db->getTable();
+    const QVector<quint32>& countries = table.countries().codes();
+    const QVector<quint8>& flags = table.flags();
+    const QVector<int>& years = table.years();
+
+    for (auto it = medalCache.begin(); it != medalCache.end(); ++it) {
+        const QString normalizedCountry = it.key().section('|', 0, 0);
+        const QString medalType = it.key().section('|', 1, 1);
+        const QString season = it.key().section('|', 2, 2);
+        QMap<int, int>& medalCounts = it.value();
+
+        // The batch may have added the country to the dictionary, so it is looked up per call
+        const quint32 country = table.countries().dictionary().find(normalizedCountry);
+        const FlagFilter seasonFilter(season);
+        const FlagFilter medalFilter(season, medalType);
+
+        for (int row = first; row <= last; ++row) {
+            if (!seasonFilter.matches(flags.at(row))) {
+                continue;
+            }
+            const int year = years.at(row);
+            if (year > 0 && !medalCounts.contains(year)) {
+                medalCounts[year] = 0;
+            }
+
+            if (countries.at(row) == country && medalFilter.matches(flags.at(row))) {
+                medalCounts[year]++;
+            }
+        }
+    }
+}
+
 QStringList OlympicGraphView::getYears(const QString& season)
 {
     QSet<int> uniqueYears;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (season == "All" || athlete.season == season) {
-            uniqueYears.insert(athlete.year);
+    const AthleteTable& table = db->getTable();
+    const QVector<quint8>& flags = table.flags();
+    const QVector<int>& years = table.years();
+    const FlagFilter seasonFilter(season);
+    for (int row = 0; row < table.size(); ++row) {
+        if (seasonFilter.matches(flags.at(row))) {
+            uniqueYears.insert(years.at(row));
         }
     }
 
@@ -506,8 +572,8 @@ void OlympicGraphView::setupCountryComparisonControls()
     multiCountrySelector->setSelectionMode(QAbstractItemView::MultiSelection);
 
     QSet<QString> countries;
-    for (const Athlete& athlete : db->getAthletes()) {
-        countries.insert(normalizeCountryName(athlete.team));
+    for (const QString& country : db->getTable().countries().dictionary().values()) {
+        countries.insert(country);
     }
 
     QStringList countryList = countries.values();
@@ -557,9 +623,9 @@ void OlympicGraphView::setupGeographicControls()
     yearCombo = new QComboBox(this);
 
     QSet<int> years;
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (athlete.year > 0) {
-            years.insert(athlete.year);
+    for (int year : db->getTable().years()) {
+        if (year > 0) {
+            years.insert(year);
         }
     }
 
@@ -797,29 +863,37 @@ void OlympicGraphView::createDemographicsChart()
     QMap<int, int> valueCounts;
     int total = 0;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (normalizeCountryName(athlete.team) != country) {
-            continue;
-        }
-
-        if (season != "All" && athlete.season != season) {
-            continue;
-        }
+    // Only the country, flag and selected measurement columns are read
+    const AthleteTable& table = db->getTable();
+    const QVector<quint32>& countries = table.countries().codes();
+    const QVector<quint8>& flags = table.flags();
+    const quint32 countryCode = table.countries().dictionary().find(country);
+    const FlagFilter seasonFilter(season);
+
+    // Age and the body measurements are stored at different widths
+    auto countValues = [&](const auto& values) {
+        for (int row = 0; row < table.size(); ++row) {
+            if (countries.at(row) != countryCode || !seasonFilter.matches(flags.at(row)) || values.isNull(row)) {
+                continue;
+            }
 
-        float value;
-        switch (attributeIndex) {
-            case 0: value = athlete.age; break;
-            case 1: value = athlete.height; break;
-            case 2: value = athlete.weight; break;
-        }
+            const float value = values.at(row);
+            if (value <= 0) {
+                continue;
+            }
 
-        if (value <= 0) {
-            continue;
+            int bucket = qRound(value);
+            valueCounts[bucket]++;
+            total++;
         }
+    };
 
-        int bucket = qRound(value);
-        valueCounts[bucket]++;
-        total++;
+    if (attributeIndex == 0) {
+        countValues(table.ages());
+    } else if (attributeIndex == 1) {
+        countValues(table.heights());
+    } else {
+        countValues(table.weights());
     }
 
     QBarSeries *series = new QBarSeries();
@@ -1050,32 +1124,31 @@ void OlympicGraphView::createGeographicChart()
     QMap<QString, int> continentMedals;
     QMap<QString, QMap<QString, int>> countriesByContinent;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (athlete.year != selectedYear) {
-            continue;
-        }
-
-        if (season != "All" && athlete.season != season) {
-            continue;
-        }
-
-        bool hasMedal = false;
-        if (medalType == "All") {
-            hasMedal = !athlete.medal.isEmpty() && athlete.medal != "NA";
-        } else {
-            hasMedal = (athlete.medal == medalType);
+    const AthleteTable& table = db->getTable();
+    const QVector<int>& years = table.years();
+    const QVector<quint8>& flags = table.flags();
+    const QVector<quint32>& countries = table.countries().codes();
+    const FlagFilter medalFilter(season, medalType);
+
+    // Count per country code first; continents are resolved once per country
+    QVector<int> countryMedals(table.countries().dictionary().size(), 0);
+    for (int row = 0; row < table.size(); ++row) {
+        if (years.at(row) == selectedYear && medalFilter.matches(flags.at(row))) {
+            countryMedals[countries.at(row)]++;
         }
+    }
 
-        if (!hasMedal) {
+    for (int code = 0; code < countryMedals.size(); ++code) {
+        if (countryMedals.at(code) == 0) {
             continue;
         }
 
-        QString normalizedCountry = normalizeCountryName(athlete.team);
+        const QString& normalizedCountry = table.countries().dictionary().value(code);
 
         QString continent = countryContinentMap.value(normalizedCountry, "Outros");
 
-        continentMedals[continent]++;
-        countriesByContinent[continent][normalizedCountry]++;
+        continentMedals[continent] += countryMedals.at(code);
+        countriesByContinent[continent][normalizedCountry] += countryMedals.at(code);
     }
 
     QPieSeries *pieSeries = new QPieSeries();
@@ -1309,24 +1382,33 @@ void OlympicGraphView::createAttributeCorrelationAnalysis(const QString &country
     QVector<float> weights;
     QVector<float> hasMedal;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (normalizeCountryName(athlete.team) != country) {
-            continue;
-        }
-
-        if (season != "All" && athlete.season != season) {
+    const AthleteTable& table = db->getTable();
+    const QVector<quint32>& countries = table.countries().codes();
+    const QVector<quint8>& flags = table.flags();
+    const AgeColumn& ageColumn = table.ages();
+    const TenthsColumn& heightColumn = table.heights();
+    const TenthsColumn& weightColumn = table.weights();
+    const quint32 countryCode = table.countries().dictionary().find(country);
+    const FlagFilter seasonFilter(season);
+
+    for (int row = 0; row < table.size(); ++row) {
+        if (countries.at(row) != countryCode || !seasonFilter.matches(flags.at(row))) {
             continue;
         }
 
-        if (athlete.age <= 0 || athlete.height <= 0 || athlete.weight <= 0) {
+        const float age = ageColumn.at(row);
+        const float height = heightColumn.at(row);
+        const float weight = weightColumn.at(row);
+        if (Athlete::isMissing(age) || Athlete::isMissing(height) || Athlete::isMissing(weight)
+            || age <= 0 || height <= 0 || weight <= 0) {
             continue;
         }
 
-        ages.append(athlete.age);
-        heights.append(athlete.height);
-        weights.append(athlete.weight);
+        ages.append(age);
+        heights.append(height);
+        weights.append(weight);
 
-        float medalValue = (!athlete.medal.isEmpty() && athlete.medal != "NA") ? 1.0f : 0.0f;
+        float medalValue = FlagFilter::hasMedal(flags.at(row)) ? 1.0f : 0.0f;
         hasMedal.append(medalValue);
     }
 
@@ -1472,19 +1554,35 @@ void OlympicGraphView::createSportDistributionAnalysis(const QString &country, c
     QMap<QString, int> sportMedals;
     QMap<QString, int> sportAthletes;
 
-    for (const Athlete& athlete : db->getAthletes()) {
-        if (normalizeCountryName(athlete.team) != country) {
+    const AthleteTable& table = db->getTable();
+    const QVector<quint32>& countries = table.countries().codes();
+    const QVector<quint8>& flags = table.flags();
+    const QVector<quint32>& sports = table.sports().codes();
+    const quint32 countryCode = table.countries().dictionary().find(country);
+    const FlagFilter seasonFilter(season);
+
+    // Tallied per sport code; the names are looked up once per sport afterwards
+    const StringDictionary& sportNames = table.sports().dictionary();
+    QVector<int> athletesByCode(sportNames.size(), 0);
+    QVector<int> medalsByCode(sportNames.size(), 0);
+    for (int row = 0; row < table.size(); ++row) {
+        if (countries.at(row) != countryCode || !seasonFilter.matches(flags.at(row))) {
             continue;
         }
 
-        if (season != "All" && athlete.season != season) {
-            continue;
+        const quint32 sport = sports.at(row);
+        athletesByCode[sport]++;
+        if (FlagFilter::hasMedal(flags.at(row))) {
+            medalsByCode[sport]++;
         }
+    }
 
-        sportAthletes[athlete.sport]++;
-
-        if (!athlete.medal.isEmpty() && athlete.medal != "NA") {
-            sportMedals[athlete.sport]++;
+    for (int code = 0; code < athletesByCode.size(); ++code) {
+        if (athletesByCode.at(code) > 0) {
+            sportAthletes[sportNames.value(code)] = athletesByCode.at(code);
+        }
+        if (medalsByCode.at(code) > 0) {
+            sportMedals[sportNames.value(code)] = medalsByCode.at(code);
         }
     }
 
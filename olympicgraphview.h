@@ -23,7 +23,6 @@
 #include <QLabel>
 #include <QListWidget>
 #include <QSettings>
-#include <QRegularExpression>
 #include <QToolTip>
 #include <QCursor>
 
@@ -43,12 +42,14 @@ public:
 
     explicit OlympicGraphView(QWidget *parent = nullptr);
     void setGraphMode(GraphMode mode);
+    void refreshData();
 
 private slots:
     void updateChart();
     void switchChartType();
     void exportChart();
     void generateChartReport();
+    void updateMedalCache(int first, int last);
 
 private:
     enum ChartType {
@@ -62,8 +63,6 @@ private:
     void clearChartData();
     void updateUI();
 
-    QString normalizeCountryName(const QString& rawName);
-
     void saveSettings();
     void loadSettings();
     void setupMedalEvolutionControls();
@@ -1,20 +1,51 @@
 #include "olympictablemodel.h"
 
+namespace {
+// Missing measurements display as empty cells and sort after every value
+QVariant measurement(float value) {
+    return Athlete::isMissing(value) ? QVariant() : QVariant(value);
+}
+
+DataBase::IndexedColumn indexedColumn(int column) {
+    switch (column) {
+    case AthleteTable::NocField: return DataBase::NocIndex;
+    case AthleteTable::YearField: return DataBase::YearIndex;
+    case AthleteTable::SeasonField: return DataBase::SeasonIndex;
+    case AthleteTable::SportField: return DataBase::SportIndex;
+    case AthleteTable::MedalField: return DataBase::MedalIndex;
+    default: return DataBase::IndexedColumnCount;
+    }
+}
+
+// "^text$" where text has no regular expression syntax beyond escaped characters
+bool anchoredLiteral(const QString& pattern, QString& literal) {
+    bool atStart = false;
+    bool atEnd = false;
+    return FilterExpression::parseLiteral(pattern, literal, atStart, atEnd) && atStart && atEnd;
+}
+}
+
 OlympicTableModel::OlympicTableModel(QObject *parent)
     : QAbstractTableModel(parent)
     , db(DataBase::getInstance())
+    , fetchedRows(db->rowCount())
+    , inserting(false)
 {
     headers << "ID" << "Name" << "Sex" << "Age" << "Height" << "Weight"
             << "Team" << "NOC" << "Games" << "Year" << "Season" << "City"
             << "Sport" << "Event" << "Medal";
 
-    connect(db, &DataBase::dataChanged, this, &OlympicTableModel::refreshData);
+    connect(db, &DataBase::aboutToBeCleared, this, &OlympicTableModel::handleAboutToBeCleared);
+    connect(db, &DataBase::cleared, this, &OlympicTableModel::handleCleared);
+    connect(db, &DataBase::rowsAboutToBeAppended, this, &OlympicTableModel::handleRowsAboutToBeAppended);
+    connect(db, &DataBase::rowsAppended, this, &OlympicTableModel::handleRowsAppended);
+    connect(db, &DataBase::streamingChanged, this, &OlympicTableModel::handleStreamingChanged);
 }
 
 int OlympicTableModel::rowCount(const QModelIndex &parent) const {
     if (parent.isValid())
         return 0;
-    return db->getAthletes().size();
+    return fetchedRows;
 }
 
 int OlympicTableModel::columnCount(const QModelIndex &parent) const {
@@ -24,27 +55,34 @@ int OlympicTableModel::columnCount(const QModelIndex &parent) const {
 }
 
 QVariant OlympicTableModel::data(const QModelIndex &index, int role) const {
-    if (!index.isValid() || role != Qt::DisplayRole)
+    if (!index.isValid())
         return QVariant();
 
-    const Athlete& athlete = db->getAthletes().at(index.row());
+    const AthleteRow athlete = db->row(index.row());
+
+    // ID, Name and Sex belong to the athlete rather than the entry
+    if (role == Qt::ToolTipRole && index.column() <= 2)
+        return careerToolTip(athlete);
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
 
     switch (index.column()) {
-    case 0: return athlete.id;
-    case 1: return athlete.name;
-    case 2: return athlete.sex;
-    case 3: return athlete.age;
-    case 4: return athlete.height;
-    case 5: return athlete.weight;
-    case 6: return athlete.team;
-    case 7: return athlete.noc;
-    case 8: return athlete.games;
-    case 9: return athlete.year;
-    case 10: return athlete.season;
-    case 11: return athlete.city;
-    case 12: return athlete.sport;
-    case 13: return athlete.event;
-    case 14: return athlete.medal;
+    case 0: return athlete.id();
+    case 1: return athlete.name();
+    case 2: return athlete.sex();
+    case 3: return measurement(athlete.age());
+    case 4: return measurement(athlete.height());
+    case 5: return measurement(athlete.weight());
+    case 6: return athlete.team();
+    case 7: return athlete.noc();
+    case 8: return athlete.games();
+    case 9: return athlete.year();
+    case 10: return athlete.season();
+    case 11: return athlete.city();
+    case 12: return athlete.sport();
+    case 13: return athlete.event();
+    case 14: return athlete.medal();
     default: return QVariant();
     }
 }
@@ -59,36 +97,332 @@ QVariant OlympicTableModel::headerData(int section, Qt::Orientation orientation,
     return QVariant();
 }
 
+bool OlympicTableModel::canFetchMore(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return false;
+    return fetchedRows < db->rowCount();
+}
+
+void OlympicTableModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid())
+        return;
+    exposeRows(qMin(FetchBatchSize, db->rowCount() - fetchedRows));
+}
+
 void OlympicTableModel::refreshData() {
     beginResetModel();
+    fetchedRows = db->rowCount();
+    careers.clear();
+    endResetModel();
+}
+
+QString OlympicTableModel::careerToolTip(const AthleteRow& athlete) const {
+    if (careers.size() != db->getTable().athletes().size())
+        careers = db->getTable().careers();
+
+    const AthleteTable::Career& career = careers.at(athlete.athlete());
+    return QString("%1\n%2 entries in %3 Games\nMedals: %4 (%5 gold, %6 silver, %7 bronze)")
+        .arg(athlete.name())
+        .arg(career.entries)
+        .arg(career.games)
+        .arg(career.medals())
+        .arg(career.gold)
+        .arg(career.silver)
+        .arg(career.bronze);
+}
+
+void OlympicTableModel::exposeRows(int count) {
+    if (count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), fetchedRows, fetchedRows + count - 1);
+    fetchedRows += count;
+    endInsertRows();
+}
+
+void OlympicTableModel::handleAboutToBeCleared() {
+    beginResetModel();
+}
+
+void OlympicTableModel::handleCleared() {
+    fetchedRows = 0;
+    careers.clear();
     endResetModel();
 }
 
+void OlympicTableModel::handleRowsAboutToBeAppended(int first, int last) {
+    // Rows only become visible contiguously; a gap left for fetchMore() stays hidden
+    if (first != fetchedRows)
+        return;
+
+    int exposedEnd = last + 1;
+    if (db->isStreaming())
+        exposedEnd = qMin(exposedEnd, qMax(fetchedRows, FetchBatchSize));
+
+    if (exposedEnd > fetchedRows) {
+        beginInsertRows(QModelIndex(), fetchedRows, exposedEnd - 1);
+        fetchedRows = exposedEnd;
+        inserting = true;
+    }
+}
+
+void OlympicTableModel::handleRowsAppended() {
+    careers.clear();
+    if (inserting) {
+        inserting = false;
+        endInsertRows();
+    }
+}
+
+void OlympicTableModel::handleStreamingChanged(bool active) {
+    if (!active)
+        exposeRows(db->rowCount() - fetchedRows);
+}
+
 OlympicFilterProxyModel::OlympicFilterProxyModel(QObject *parent)
-    : QSortFilterProxyModel(parent)
+    : QAbstractProxyModel(parent)
+    , exactRowCount(-1)
+    , sortColumn(-1)
+    , sortOrder(Qt::AscendingOrder)
 {
-    setSortCaseSensitivity(Qt::CaseInsensitive);
+    // A reload can end with as many rows as before, so the row count alone cannot tell
+    connect(DataBase::getInstance(), &DataBase::cleared, this, [this]() { exactRowCount = -1; });
+}
+
+void OlympicFilterProxyModel::setSourceModel(QAbstractItemModel *model) {
+    beginResetModel();
+    if (sourceModel())
+        disconnect(sourceModel(), nullptr, this, nullptr);
+
+    QAbstractProxyModel::setSourceModel(model);
+
+    if (model) {
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &OlympicFilterProxyModel::handleSourceAboutToBeReset);
+        connect(model, &QAbstractItemModel::modelReset, this, &OlympicFilterProxyModel::handleSourceReset);
+        connect(model, &QAbstractItemModel::rowsInserted, this, &OlympicFilterProxyModel::handleSourceRowsInserted);
+        // The table model only appends, so anything else is treated as a reset
+        connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &OlympicFilterProxyModel::handleSourceAboutToBeReset);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &OlympicFilterProxyModel::handleSourceReset);
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &OlympicFilterProxyModel::handleSourceAboutToBeReset);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &OlympicFilterProxyModel::handleSourceReset);
+    }
+
+    setRows(orderedRows(acceptedRows(0, sourceRowCount())));
+    endResetModel();
+}
+
+QModelIndex OlympicFilterProxyModel::index(int row, int column, const QModelIndex &parent) const {
+    if (parent.isValid() || row < 0 || row >= sourceRows.size() || column < 0 || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex OlympicFilterProxyModel::parent(const QModelIndex &) const {
+    return QModelIndex();
+}
+
+int OlympicFilterProxyModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+    return sourceRows.size();
+}
+
+int OlympicFilterProxyModel::columnCount(const QModelIndex &parent) const {
+    if (parent.isValid() || !sourceModel())
+        return 0;
+    return sourceModel()->columnCount();
+}
+
+QVariant OlympicFilterProxyModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (!sourceModel())
+        return QVariant();
+    // Column headers do not depend on the rows, so they stay when every row is filtered out
+    if (orientation == Qt::Vertical && section >= 0 && section < sourceRows.size())
+        section = sourceRows.at(section);
+    return sourceModel()->headerData(section, orientation, role);
+}
+
+QModelIndex OlympicFilterProxyModel::mapToSource(const QModelIndex &proxyIndex) const {
+    if (!proxyIndex.isValid() || !sourceModel())
+        return QModelIndex();
+    return sourceModel()->index(sourceRows.at(proxyIndex.row()), proxyIndex.column());
+}
+
+QModelIndex OlympicFilterProxyModel::mapFromSource(const QModelIndex &sourceIndex) const {
+    if (!sourceIndex.isValid() || sourceIndex.row() >= proxyRows.size())
+        return QModelIndex();
+    const int row = proxyRows.at(sourceIndex.row());
+    return row < 0 ? QModelIndex() : index(row, sourceIndex.column());
+}
+
+void OlympicFilterProxyModel::sort(int column, Qt::SortOrder order) {
+    sortColumn = column;
+    sortOrder = order;
+    if (sourceModel())
+        reorderRows(orderedRows(currentRows()));
 }
 
 void OlympicFilterProxyModel::setColumnFilter(int column, const QString& pattern) {
-    if (pattern.isEmpty())
-        columnFilters.remove(column);
-    else
-        columnFilters[column] = QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
-    invalidateFilter();
+    addFilter(column, pattern);
+    exactRowCount = -1;
+    refilter();
+}
+
+void OlympicFilterProxyModel::setColumnFilters(const QMap<int, QString>& patterns) {
+    exactFilters.clear();
+    expressionFilters.clear();
+    for (auto it = patterns.constBegin(); it != patterns.constEnd(); ++it)
+        addFilter(it.key(), it.value());
+    exactRowCount = -1;
+    refilter();
+}
+
+void OlympicFilterProxyModel::addFilter(int column, const QString& pattern) {
+    exactFilters.remove(column);
+    expressionFilters.remove(column);
+
+    QString value;
+    if (pattern.isEmpty() || column < 0 || column >= AthleteTable::FieldCount) {
+        // Nothing to filter on
+    } else if (indexedColumn(column) != DataBase::IndexedColumnCount && anchoredLiteral(pattern, value)) {
+        exactFilters[column] = value;
+    } else {
+        // Anything that is not an expression is a regular expression search, as filters always were
+        const AthleteTable::Field field = static_cast<AthleteTable::Field>(column);
+        const FilterExpression expression = FilterExpression::parse(pattern, field);
+        expressionFilters[column] = expression.isValid() ? expression : FilterExpression::match(field, pattern);
+    }
 }
 
 void OlympicFilterProxyModel::clearFilters() {
-    columnFilters.clear();
-    invalidateFilter();
+    exactFilters.clear();
+    expressionFilters.clear();
+    exactRowCount = -1;
+    refilter();
+}
+
+void OlympicFilterProxyModel::updateExactRows() const {
+    const DataBase* db = DataBase::getInstance();
+
+    auto it = exactFilters.constBegin();
+    exactRows = db->rowsEqualTo(indexedColumn(it.key()), it.value(), Qt::CaseInsensitive);
+    for (++it; it != exactFilters.constEnd() && !exactRows.isEmpty(); ++it)
+        exactRows = exactRows & db->rowsEqualTo(indexedColumn(it.key()), it.value(), Qt::CaseInsensitive);
+    exactRowCount = db->rowCount();
+}
+
+int OlympicFilterProxyModel::acceptedRowCount() const {
+    if (exactFilters.isEmpty() || !expressionFilters.isEmpty())
+        return rowCount();
+    if (exactRowCount != DataBase::getInstance()->rowCount())
+        updateExactRows();
+    // The bitmap covers the whole database; the proxy only holds rows the source has fetched
+    const int fetched = sourceRowCount();
+    if (fetched == exactRowCount)
+        return exactRows.count();
+    return (exactRows & RowBitmap::range(0, fetched)).count();
+}
+
+void OlympicFilterProxyModel::handleSourceAboutToBeReset() {
+    beginResetModel();
+}
+
+void OlympicFilterProxyModel::handleSourceReset() {
+    setRows(orderedRows(acceptedRows(0, sourceRowCount())));
+    endResetModel();
+}
+
+void OlympicFilterProxyModel::handleSourceRowsInserted(const QModelIndex &parent, int first, int last) {
+    if (parent.isValid())
+        return;
+    if (first != proxyRows.size()) {
+        refilter();
+        return;
+    }
+
+    const QVector<int> added = acceptedRows(first, last + 1).rows();
+    proxyRows.reserve(last + 1);
+    while (proxyRows.size() <= last)
+        proxyRows.append(-1);
+    if (added.isEmpty())
+        return;
+
+    // New rows go to the end first and move into place with the next sort
+    beginInsertRows(QModelIndex(), sourceRows.size(), sourceRows.size() + added.size() - 1);
+    for (int row : added) {
+        proxyRows[row] = sourceRows.size();
+        sourceRows.append(row);
+    }
+    endInsertRows();
+
+    if (sortColumn >= 0)
+        reorderRows(orderedRows(currentRows()));
+}
+
+int OlympicFilterProxyModel::sourceRowCount() const {
+    return sourceModel() ? sourceModel()->rowCount() : 0;
+}
+
+RowBitmap OlympicFilterProxyModel::acceptedRows(int first, int end) const {
+    RowBitmap rows = RowBitmap::range(first, end);
+    if (!exactFilters.isEmpty()) {
+        if (exactRowCount != DataBase::getInstance()->rowCount())
+            updateExactRows();
+        rows = rows & exactRows;
+    }
+    const AthleteTable& table = DataBase::getInstance()->getTable();
+    for (auto it = expressionFilters.constBegin(); it != expressionFilters.constEnd() && !rows.isEmpty(); ++it)
+        rows = rows & it.value().evaluate(table, first, end);
+    return rows;
 }
 
-bool OlympicFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const {
-    for (auto it = columnFilters.constBegin(); it != columnFilters.constEnd(); ++it) {
-        QModelIndex index = sourceModel()->index(sourceRow, it.key(), sourceParent);
-        QString text = sourceModel()->data(index, Qt::DisplayRole).toString();
-        if (!text.contains(it.value()))
-            return false;
+RowBitmap OlympicFilterProxyModel::currentRows() const {
+    RowBitmap rows;
+    for (int row = 0; row < proxyRows.size(); ++row) {
+        if (proxyRows.at(row) >= 0)
+            rows.add(row);
     }
-    return true;
+    return rows;
+}
+
+QVector<int> OlympicFilterProxyModel::orderedRows(const RowBitmap& accepted) const {
+    // Columns follow AthleteTable::Field
+    if (sortColumn < 0 || sortColumn >= AthleteTable::FieldCount)
+        return accepted.rows();
+    return DataBase::getInstance()->sortedRows(accepted, static_cast<AthleteTable::Field>(sortColumn), sortOrder);
+}
+
+void OlympicFilterProxyModel::setRows(const QVector<int>& ordered) {
+    sourceRows = ordered;
+    proxyRows.fill(-1, sourceRowCount());
+    for (int row = 0; row < sourceRows.size(); ++row)
+        proxyRows[sourceRows.at(row)] = row;
+}
+
+void OlympicFilterProxyModel::reorderRows(const QVector<int>& ordered) {
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    const QModelIndexList before = persistentIndexList();
+    QVector<int> persistentSourceRows;
+    persistentSourceRows.reserve(before.size());
+    for (const QModelIndex& index : before)
+        persistentSourceRows.append(sourceRows.at(index.row()));
+
+    setRows(ordered);
+
+    QModelIndexList after;
+    after.reserve(before.size());
+    for (int i = 0; i < before.size(); ++i)
+        after.append(index(proxyRows.at(persistentSourceRows.at(i)), before.at(i).column()));
+    changePersistentIndexList(before, after);
+
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+void OlympicFilterProxyModel::refilter() {
+    // The new rows are complete before the view sees the reset
+    const QVector<int> rows = orderedRows(acceptedRows(0, sourceRowCount()));
+    beginResetModel();
+    setRows(rows);
+    endResetModel();
 }
@@ -2,10 +2,11 @@
 #define OLYMPICTABLEMODEL_H
 
 #include <QAbstractTableModel>
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
+#include <QMap>
 #include <QVector>
-#include <QRegularExpression>
 #include "database.h"
+#include "filterexpression.h"
 
 class OlympicTableModel : public QAbstractTableModel {
     Q_OBJECT
@@ -16,26 +17,90 @@ public:
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
     void refreshData();
 
+    // While the database is streaming, rows beyond the first window are only
+    // exposed on fetchMore(); everything is exposed once streaming ends.
+    static constexpr int FetchBatchSize = 20000;
+
+private slots:
+    void handleAboutToBeCleared();
+    void handleCleared();
+    void handleRowsAboutToBeAppended(int first, int last);
+    void handleRowsAppended();
+    void handleStreamingChanged(bool active);
+
 private:
+    void exposeRows(int count);
+    QString careerToolTip(const AthleteRow& athlete) const;
+
     DataBase* db;
     QStringList headers;
+    int fetchedRows;
+    bool inserting;
+    // Built on the first tooltip and dropped whenever rows change
+    mutable QVector<AthleteTable::Career> careers;
 };
 
-class OlympicFilterProxyModel : public QSortFilterProxyModel {
+// Filtering and sorting proxy that keeps the accepted source rows as one
+// flat vector in display order, plus its inverse, so mapping either way is a
+// lookup. Filter and sort changes build the new vector from the database's
+// indexes before swapping it in.
+class OlympicFilterProxyModel : public QAbstractProxyModel {
     Q_OBJECT
 
 public:
     explicit OlympicFilterProxyModel(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
     void setColumnFilter(int column, const QString& pattern);
+    // Replaces every filter at once, with a single refilter and model reset.
+    void setColumnFilters(const QMap<int, QString>& patterns);
     void clearFilters();
 
-protected:
-    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+    // Number of fetched source rows passing the filters, counted from the row
+    // bitmap when every filter is resolved through an index.
+    int acceptedRowCount() const;
+
+private slots:
+    void handleSourceAboutToBeReset();
+    void handleSourceReset();
+    void handleSourceRowsInserted(const QModelIndex &parent, int first, int last);
 
 private:
-    QMap<int, QRegularExpression> columnFilters;
+    int sourceRowCount() const;
+    RowBitmap acceptedRows(int first, int end) const;
+    RowBitmap currentRows() const;
+    QVector<int> orderedRows(const RowBitmap& accepted) const;
+    void setRows(const QVector<int>& ordered);
+    void reorderRows(const QVector<int>& ordered);
+    void addFilter(int column, const QString& pattern);
+    void refilter();
+    void updateExactRows() const;
+
+    // ^value$ filters on indexed columns are resolved by combining the
+    // database's row bitmaps instead of matching each row's text.
+    QMap<int, QString> exactFilters;
+    mutable RowBitmap exactRows;
+    mutable int exactRowCount;  // rows in the database when exactRows was built
+    // Every other filter, plain regular expressions included, evaluated on the columns
+    QMap<int, FilterExpression> expressionFilters;
+
+    int sortColumn;  // -1 keeps source order
+    Qt::SortOrder sortOrder;
+    QVector<int> sourceRows;  // per proxy row
+    QVector<int> proxyRows;   // per source row, -1 when filtered out
 };
 
 #endif // OLYMPICTABLEMODEL_H
@@ -53,21 +53,19 @@ void OlympicTableView::setupUI() {
     QHeaderView* header = tableView->horizontalHeader();
     header->setSectionResizeMode(QHeaderView::Fixed);
 
-    const int sortIndicatorWidth = 26;
-
-    for(int column = 0; column < sourceModel->columnCount(); ++column) {
-        tableView->resizeColumnToContents(column);
-
-        int currentWidth = tableView->columnWidth(column);
-        tableView->setColumnWidth(column, currentWidth + sortIndicatorWidth);
-    }
+    fitColumnsToContents();
 
     mainLayout->addWidget(tableView);
 
     connect(addFilterButton, &QPushButton::clicked, this, &OlympicTableView::addFilterRow);
     connect(applyFiltersButton, &QPushButton::clicked, this, &OlympicTableView::applyFilter);
     connect(clearAllButton, &QPushButton::clicked, this, &OlympicTableView::clearFilters);
-    connect(proxyModel, &QSortFilterProxyModel::layoutChanged, this, &OlympicTableView::updateRowCountLabel);
+    connect(proxyModel, &OlympicFilterProxyModel::layoutChanged, this, &OlympicTableView::updateRowCountLabel);
+    connect(proxyModel, &OlympicFilterProxyModel::rowsInserted, this, &OlympicTableView::updateRowCountLabel);
+    connect(proxyModel, &OlympicFilterProxyModel::modelReset, this, &OlympicTableView::updateRowCountLabel);
+    connect(sourceModel, &OlympicTableModel::rowsInserted, this, &OlympicTableView::handleRowsInserted);
+    connect(DataBase::getInstance(), &DataBase::rowsAppended, this, &OlympicTableView::updateRowCountLabel);
+    connect(DataBase::getInstance(), &DataBase::streamingChanged, this, &OlympicTableView::updateRowCountLabel);
     connect(exportButton, &QPushButton::clicked, this, &OlympicTableView::exportData);
     connect(reportButton, &QPushButton::clicked, this, &OlympicTableView::generateReport);
 
@@ -76,6 +74,24 @@ void OlympicTableView::setupUI() {
     updateRowCountLabel();
 }
 
+void OlympicTableView::fitColumnsToContents() {
+    const int sortIndicatorWidth = 26;
+
+    for(int column = 0; column < sourceModel->columnCount(); ++column) {
+        tableView->resizeColumnToContents(column);
+
+        int currentWidth = tableView->columnWidth(column);
+        tableView->setColumnWidth(column, currentWidth + sortIndicatorWidth);
+    }
+}
+
+void OlympicTableView::handleRowsInserted(const QModelIndex& parent, int first) {
+    // The table can be created before any data arrives; size columns on the first rows
+    if (!parent.isValid() && first == 0) {
+        fitColumnsToContents();
+    }
+}
+
 void OlympicTableView::createFilterRow() {
     FilterRow filterRow;
 
@@ -88,7 +104,7 @@ void OlympicTableView::createFilterRow() {
                                      "Sport", "Event", "Medal"});
 
     filterRow.patternEdit = new QLineEdit(this);
-    filterRow.patternEdit->setPlaceholderText("Enter filter pattern (regex supported)");
+    filterRow.patternEdit->setPlaceholderText("Regex, or an expression such as >= 2000, between 20 and 25 or in (USA, BRA)");
 
     filterRow.removeButton = new QPushButton("Remove", this);
 
@@ -105,14 +121,14 @@ void OlympicTableView::createFilterRow() {
 }
 
 void OlympicTableView::applyFilter() {
-    proxyModel->clearFilters();
-
+    QMap<int, QString> patterns;
     for (const FilterRow& row : filterRows) {
         QString pattern = row.patternEdit->text();
         if (!pattern.isEmpty()) {
-            proxyModel->setColumnFilter(row.columnCombo->currentIndex(), pattern);
+            patterns[row.columnCombo->currentIndex()] = pattern;
         }
     }
+    proxyModel->setColumnFilters(patterns);
     updateRowCountLabel();
 }
 
@@ -143,8 +159,8 @@ void OlympicTableView::removeFilterRow() {
 }
 
 void OlympicTableView::updateRowCountLabel() {
-    int visibleRows = proxyModel->rowCount();
-    int totalRows = sourceModel->rowCount();
+    int visibleRows = proxyModel->acceptedRowCount();
+    int totalRows = DataBase::getInstance()->rowCount();
     rowCountLabel->setText(QString("Displaying %1 out of %2 total rows")
                                .arg(visibleRows)
                                .arg(totalRows));
@@ -22,6 +22,7 @@ private slots:
     void addFilterRow();
     void removeFilterRow();
     void updateRowCountLabel();
+    void handleRowsInserted(const QModelIndex& parent, int first);
     void exportData();
     void generateReport();
 
@@ -48,6 +49,7 @@ private:
 
     void setupUI();
     void createFilterRow();
+    void fitColumnsToContents();
 };
 
 #endif // OLYMPICTABLEVIEW_H
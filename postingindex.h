@@ -0,0 +1,22 @@
+#ifndef POSTINGINDEX_H
+#define POSTINGINDEX_H
+
+#include <QHash>
+
+#include "rowbitmap.h"
+
+// Inverted index over one categorical column: for every key, the set of
+// rows that hold it as a compressed bitmap.
+class PostingIndex {
+public:
+    void add(quint32 key, int row) { postings[key].add(row); }
+    void clear() { postings.clear(); }
+
+    // Rows holding key; empty when no row does.
+    RowBitmap rows(quint32 key) const { return postings.value(key); }
+
+private:
+    QHash<quint32, RowBitmap> postings;
+};
+
+#endif // POSTINGINDEX_H
@@ -0,0 +1,329 @@
+#include "rowbitmap.h"
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+namespace {
+
+typedef RowBitmap::Chunk Chunk;
+
+const int ArrayLimit = 4096;
+const int WordCount = 1024;
+
+void makeDense(Chunk& chunk) {
+    chunk.words.fill(0, WordCount);
+    for (quint16 low : chunk.values) {
+        chunk.words[low >> 6] |= quint64(1) << (low & 63);
+    }
+    chunk.values.clear();
+}
+
+// Recounts a chunk whose words were just computed and turns it back into an
+// array when few rows are left
+void finishDense(Chunk& chunk) {
+    int cardinality = 0;
+    for (quint64 word : chunk.words) {
+        cardinality += qPopulationCount(word);
+    }
+    chunk.cardinality = cardinality;
+    if (cardinality > ArrayLimit) {
+        return;
+    }
+
+    chunk.values.reserve(cardinality);
+    for (int index = 0; index < WordCount; ++index) {
+        for (quint64 word = chunk.words.at(index); word != 0; word &= word - 1) {
+            chunk.values.append(static_cast<quint16>(index * 64 + qCountTrailingZeroBits(word)));
+        }
+    }
+    chunk.words.clear();
+}
+
+void finishArray(Chunk& chunk) {
+    chunk.cardinality = chunk.values.size();
+    if (chunk.cardinality > ArrayLimit) {
+        makeDense(chunk);
+    }
+}
+
+Chunk intersect(const Chunk& left, const Chunk& right) {
+    Chunk result;
+    result.key = left.key;
+    if (left.isDense() && right.isDense()) {
+        result.words.resize(WordCount);
+        for (int index = 0; index < WordCount; ++index) {
+            result.words[index] = left.words.at(index) & right.words.at(index);
+        }
+        finishDense(result);
+    } else if (left.isDense() || right.isDense()) {
+        const Chunk& sparse = left.isDense() ? right : left;
+        const Chunk& dense = left.isDense() ? left : right;
+        for (quint16 low : sparse.values) {
+            if (dense.contains(low)) {
+                result.values.append(low);
+            }
+        }
+        finishArray(result);
+    } else {
+        std::set_intersection(left.values.begin(), left.values.end(),
+                              right.values.begin(), right.values.end(),
+                              std::back_inserter(result.values));
+        finishArray(result);
+    }
+    return result;
+}
+
+Chunk unite(const Chunk& left, const Chunk& right) {
+    Chunk result;
+    result.key = left.key;
+    if (left.isDense() || right.isDense()) {
+        const Chunk& dense = left.isDense() ? left : right;
+        const Chunk& other = left.isDense() ? right : left;
+        result.words = dense.words;
+        if (other.isDense()) {
+            for (int index = 0; index < WordCount; ++index) {
+                result.words[index] |= other.words.at(index);
+            }
+        } else {
+            for (quint16 low : other.values) {
+                result.words[low >> 6] |= quint64(1) << (low & 63);
+            }
+        }
+        finishDense(result);
+    } else {
+        std::set_union(left.values.begin(), left.values.end(),
+                       right.values.begin(), right.values.end(),
+                       std::back_inserter(result.values));
+        finishArray(result);
+    }
+    return result;
+}
+
+Chunk subtract(const Chunk& left, const Chunk& right) {
+    Chunk result;
+    result.key = left.key;
+    if (left.isDense()) {
+        result.words = left.words;
+        if (right.isDense()) {
+            for (int index = 0; index < WordCount; ++index) {
+                result.words[index] &= ~right.words.at(index);
+            }
+        } else {
+            for (quint16 low : right.values) {
+                result.words[low >> 6] &= ~(quint64(1) << (low & 63));
+            }
+        }
+        finishDense(result);
+    } else if (right.isDense()) {
+        for (quint16 low : left.values) {
+            if (!right.contains(low)) {
+                result.values.append(low);
+            }
+        }
+        finishArray(result);
+    } else {
+        std::set_difference(left.values.begin(), left.values.end(),
+                            right.values.begin(), right.values.end(),
+                            std::back_inserter(result.values));
+        finishArray(result);
+    }
+    return result;
+}
+
+bool keyLess(const Chunk& chunk, quint16 key) {
+    return chunk.key < key;
+}
+
+}
+
+bool RowBitmap::Chunk::contains(quint16 low) const {
+    if (isDense()) {
+        return (words.at(low >> 6) & (quint64(1) << (low & 63))) != 0;
+    }
+    return std::binary_search(values.begin(), values.end(), low);
+}
+
+RowBitmap RowBitmap::range(int first, int end) {
+    RowBitmap bitmap;
+    first = qMax(first, 0);
+    while (first < end) {
+        Chunk chunk;
+        chunk.key = static_cast<quint16>(first >> 16);
+        const int chunkEnd = qMin(end, (first | 0xffff) + 1);
+        chunk.cardinality = chunkEnd - first;
+
+        int low = first & 0xffff;
+        const int lowEnd = low + chunk.cardinality;
+        if (chunk.cardinality > ArrayLimit) {
+            chunk.words.fill(0, WordCount);
+            for (; low < lowEnd && (low & 63) != 0; ++low) {
+                chunk.words[low >> 6] |= quint64(1) << (low & 63);
+            }
+            for (; low + 64 <= lowEnd; low += 64) {
+                chunk.words[low >> 6] = ~quint64(0);
+            }
+            for (; low < lowEnd; ++low) {
+                chunk.words[low >> 6] |= quint64(1) << (low & 63);
+            }
+        } else {
+            chunk.values.reserve(chunk.cardinality);
+            for (; low < lowEnd; ++low) {
+                chunk.values.append(static_cast<quint16>(low));
+            }
+        }
+
+        bitmap.chunks.append(chunk);
+        first = chunkEnd;
+    }
+    return bitmap;
+}
+
+RowBitmap::Chunk* RowBitmap::chunkFor(quint16 key) {
+    // Rows are usually added in order, so the last chunk is the likely one
+    if (chunks.isEmpty() || chunks.last().key < key) {
+        Chunk chunk;
+        chunk.key = key;
+        chunks.append(chunk);
+        return &chunks.last();
+    }
+    if (chunks.last().key == key) {
+        return &chunks.last();
+    }
+
+    auto it = std::lower_bound(chunks.begin(), chunks.end(), key, keyLess);
+    if (it->key != key) {
+        Chunk chunk;
+        chunk.key = key;
+        it = chunks.insert(it, chunk);
+    }
+    return &*it;
+}
+
+void RowBitmap::add(int row) {
+    if (row < 0) {
+        return;
+    }
+
+    Chunk& chunk = *chunkFor(static_cast<quint16>(row >> 16));
+    const quint16 low = static_cast<quint16>(row & 0xffff);
+    if (chunk.isDense()) {
+        quint64& word = chunk.words[low >> 6];
+        const quint64 bit = quint64(1) << (low & 63);
+        if ((word & bit) == 0) {
+            word |= bit;
+            ++chunk.cardinality;
+        }
+        return;
+    }
+
+    if (chunk.values.isEmpty() || chunk.values.last() < low) {
+        chunk.values.append(low);
+    } else {
+        auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+        if (*it == low) {
+            return;
+        }
+        chunk.values.insert(it, low);
+    }
+    finishArray(chunk);
+}
+
+bool RowBitmap::contains(int row) const {
+    if (row < 0) {
+        return false;
+    }
+    const quint16 key = static_cast<quint16>(row >> 16);
+    auto it = std::lower_bound(chunks.begin(), chunks.end(), key, keyLess);
+    return it != chunks.end() && it->key == key && it->contains(static_cast<quint16>(row & 0xffff));
+}
+
+int RowBitmap::count() const {
+    int total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.cardinality;
+    }
+    return total;
+}
+
+QVector<int> RowBitmap::rows() const {
+    QVector<int> result;
+    result.reserve(count());
+    for (const Chunk& chunk : chunks) {
+        const int base = int(chunk.key) << 16;
+        if (chunk.isDense()) {
+            for (int index = 0; index < WordCount; ++index) {
+                for (quint64 word = chunk.words.at(index); word != 0; word &= word - 1) {
+                    result.append(base + index * 64 + qCountTrailingZeroBits(word));
+                }
+            }
+        } else {
+            for (quint16 low : chunk.values) {
+                result.append(base + low);
+            }
+        }
+    }
+    return result;
+}
+
+RowBitmap RowBitmap::operator&(const RowBitmap& other) const {
+    RowBitmap result;
+    int i = 0;
+    int j = 0;
+    while (i < chunks.size() && j < other.chunks.size()) {
+        const Chunk& left = chunks.at(i);
+        const Chunk& right = other.chunks.at(j);
+        if (left.key < right.key) {
+            ++i;
+        } else if (right.key < left.key) {
+            ++j;
+        } else {
+            const Chunk chunk = intersect(left, right);
+            if (chunk.cardinality > 0) {
+                result.chunks.append(chunk);
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+RowBitmap RowBitmap::operator|(const RowBitmap& other) const {
+    RowBitmap result;
+    int i = 0;
+    int j = 0;
+    while (i < chunks.size() || j < other.chunks.size()) {
+        if (j == other.chunks.size() || (i < chunks.size() && chunks.at(i).key < other.chunks.at(j).key)) {
+            result.chunks.append(chunks.at(i++));
+        } else if (i == chunks.size() || other.chunks.at(j).key < chunks.at(i).key) {
+            result.chunks.append(other.chunks.at(j++));
+        } else {
+            result.chunks.append(unite(chunks.at(i++), other.chunks.at(j++)));
+        }
+    }
+    return result;
+}
+
+RowBitmap RowBitmap::operator-(const RowBitmap& other) const {
+    RowBitmap result;
+    int j = 0;
+    for (const Chunk& left : chunks) {
+        while (j < other.chunks.size() && other.chunks.at(j).key < left.key) {
+            ++j;
+        }
+        if (j == other.chunks.size() || other.chunks.at(j).key != left.key) {
+            result.chunks.append(left);
+            continue;
+        }
+        const Chunk chunk = subtract(left, other.chunks.at(j));
+        if (chunk.cardinality > 0) {
+            result.chunks.append(chunk);
+        }
+    }
+    return result;
+}
+
+RowBitmap RowBitmap::complement(int rowCount) const {
+    return range(0, rowCount) - *this;
+}
@@ -0,0 +1,47 @@
+#ifndef ROWBITMAP_H
+#define ROWBITMAP_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Compressed set of row numbers in the style of a Roaring bitmap. Rows are
+// split into chunks of 65536 by their high 16 bits; a chunk keeps its low
+// bits as a sorted array while it holds at most 4096 rows and as a 1024-word
+// bitmap beyond that. Set operations go chunk by chunk and, between two
+// bitmap chunks, one 64-bit word at a time.
+class RowBitmap {
+public:
+    // Rows first..end-1.
+    static RowBitmap range(int first, int end);
+
+    // Cheapest when rows arrive in ascending order.
+    void add(int row);
+    bool contains(int row) const;
+
+    bool isEmpty() const { return chunks.isEmpty(); }
+    int count() const;
+    QVector<int> rows() const;  // ascending
+
+    RowBitmap operator&(const RowBitmap& other) const;
+    RowBitmap operator|(const RowBitmap& other) const;
+    RowBitmap operator-(const RowBitmap& other) const;
+    // Rows below rowCount that are not in the set.
+    RowBitmap complement(int rowCount) const;
+
+    struct Chunk {
+        quint16 key = 0;
+        int cardinality = 0;
+        QVector<quint16> values;  // sorted, while sparse
+        QVector<quint64> words;   // once dense; values is then empty
+
+        bool isDense() const { return !words.isEmpty(); }
+        bool contains(quint16 low) const;
+    };
+
+private:
+    Chunk* chunkFor(quint16 key);
+
+    QVector<Chunk> chunks;  // ascending by key, none empty
+};
+
+#endif // ROWBITMAP_H
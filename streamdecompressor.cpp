@@ -0,0 +1,219 @@
+#include "streamdecompressor.h"
+
+#include <QDebug>
+#include <QIODevice>
+
+#ifdef OLYMPICBROWSER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef OLYMPICBROWSER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstring>
+
+namespace {
+
+const int InputBlockBytes = 1 << 20;
+
+#ifdef OLYMPICBROWSER_HAVE_ZLIB
+class GzipDecompressor : public StreamDecompressor {
+public:
+    explicit GzipDecompressor(QIODevice& device)
+        : device(device), input(InputBlockBytes, Qt::Uninitialized), consumed(0), inMember(false)
+    {
+        std::memset(&stream, 0, sizeof(stream));
+        // 16 + MAX_WBITS selects the gzip wrapper
+        initialized = inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK;
+    }
+
+    ~GzipDecompressor() override {
+        if (initialized) {
+            inflateEnd(&stream);
+        }
+    }
+
+    bool read(QByteArray& out, int maxBytes, bool& atEnd) override {
+        atEnd = false;
+        if (!initialized) {
+            return false;
+        }
+
+        const int start = out.size();
+        out.resize(start + maxBytes);
+        stream.next_out = reinterpret_cast<Bytef*>(out.data() + start);
+        stream.avail_out = static_cast<uInt>(maxBytes);
+
+        bool ok = true;
+        while (stream.avail_out > 0) {
+            if (stream.avail_in == 0) {
+                const qint64 count = device.read(input.data(), input.size());
+                if (count <= 0) {
+                    // A member cut short means the archive is truncated
+                    ok = count == 0 && !inMember;
+                    atEnd = true;
+                    break;
+                }
+                consumed += count;
+                stream.next_in = reinterpret_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(count);
+            }
+
+            const int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                // Archives written by pigz or appended with cat hold several members
+                inMember = false;
+                if (inflateReset(&stream) != Z_OK) {
+                    ok = false;
+                    break;
+                }
+            } else if (status == Z_OK || status == Z_BUF_ERROR) {
+                inMember = true;
+            } else {
+                qDebug() << "gzip decoding failed:" << (stream.msg ? stream.msg : "unknown error");
+                ok = false;
+                break;
+            }
+        }
+
+        out.resize(out.size() - static_cast<int>(stream.avail_out));
+        return ok;
+    }
+
+    qint64 inputPosition() const override {
+        return consumed;
+    }
+
+private:
+    QIODevice& device;
+    QByteArray input;
+    z_stream stream;
+    qint64 consumed;
+    bool initialized;
+    bool inMember;
+};
+#endif
+
+#ifdef OLYMPICBROWSER_HAVE_ZSTD
+class ZstdDecompressor : public StreamDecompressor {
+public:
+    explicit ZstdDecompressor(QIODevice& device)
+        : device(device), input(InputBlockBytes, Qt::Uninitialized), context(ZSTD_createDCtx()), consumed(0), inFrame(false)
+    {
+        inBuffer.src = input.constData();
+        inBuffer.size = 0;
+        inBuffer.pos = 0;
+    }
+
+    ~ZstdDecompressor() override {
+        ZSTD_freeDCtx(context);
+    }
+
+    bool read(QByteArray& out, int maxBytes, bool& atEnd) override {
+        atEnd = false;
+        if (!context) {
+            return false;
+        }
+
+        const int start = out.size();
+        out.resize(start + maxBytes);
+        ZSTD_outBuffer outBuffer = {out.data() + start, static_cast<size_t>(maxBytes), 0};
+
+        bool ok = true;
+        while (outBuffer.pos < outBuffer.size) {
+            if (inBuffer.pos == inBuffer.size) {
+                const qint64 count = device.read(input.data(), input.size());
+                if (count <= 0) {
+                    ok = count == 0 && !inFrame;
+                    atEnd = true;
+                    break;
+                }
+                consumed += count;
+                inBuffer.size = static_cast<size_t>(count);
+                inBuffer.pos = 0;
+            }
+
+            const size_t status = ZSTD_decompressStream(context, &outBuffer, &inBuffer);
+            if (ZSTD_isError(status)) {
+                qDebug() << "zstd decoding failed:" << ZSTD_getErrorName(status);
+                ok = false;
+                break;
+            }
+            // Zero means a frame just ended; concatenated frames simply continue
+            inFrame = status != 0;
+        }
+
+        out.resize(start + static_cast<int>(outBuffer.pos));
+        return ok;
+    }
+
+    qint64 inputPosition() const override {
+        return consumed;
+    }
+
+private:
+    QIODevice& device;
+    QByteArray input;
+    ZSTD_DCtx* context;
+    ZSTD_inBuffer inBuffer;
+    qint64 consumed;
+    bool inFrame;
+};
+#endif
+
+}
+
+StreamDecompressor::Format StreamDecompressor::detect(QIODevice& device) {
+    const QByteArray magic = device.peek(4);
+    if (magic.startsWith("\x1f\x8b")) {
+        return GzipFormat;
+    }
+    if (magic == QByteArray("\x28\xb5\x2f\xfd", 4)) {
+        return ZstdFormat;
+    }
+    return PlainFormat;
+}
+
+bool StreamDecompressor::isSupported(Format format) {
+    switch (format) {
+    case PlainFormat:
+        return true;
+    case GzipFormat:
+#ifdef OLYMPICBROWSER_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case ZstdFormat:
+#ifdef OLYMPICBROWSER_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char* StreamDecompressor::formatName(Format format) {
+    switch (format) {
+    case GzipFormat: return "gzip";
+    case ZstdFormat: return "zstd";
+    default: return "plain";
+    }
+}
+
+std::unique_ptr<StreamDecompressor> StreamDecompressor::create(Format format, QIODevice& device) {
+    switch (format) {
+#ifdef OLYMPICBROWSER_HAVE_ZLIB
+    case GzipFormat:
+        return std::unique_ptr<StreamDecompressor>(new GzipDecompressor(device));
+#endif
+#ifdef OLYMPICBROWSER_HAVE_ZSTD
+    case ZstdFormat:
+        return std::unique_ptr<StreamDecompressor>(new ZstdDecompressor(device));
+#endif
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef STREAMDECOMPRESSOR_H
+#define STREAMDECOMPRESSOR_H
+
+#include <QByteArray>
+
+#include <memory>
+
+class QIODevice;
+
+// Incremental decoder for compressed datasets. gzip needs zlib and zstd needs
+// libzstd at build time; isSupported() reports what this build can read.
+class StreamDecompressor {
+public:
+    enum Format {
+        PlainFormat,
+        GzipFormat,
+        ZstdFormat
+    };
+
+    virtual ~StreamDecompressor() {}
+
+    // Sniffs the magic bytes without consuming them.
+    static Format detect(QIODevice& device);
+    static bool isSupported(Format format);
+    static const char* formatName(Format format);
+
+    // Returns nullptr for PlainFormat or when the format is not compiled in.
+    static std::unique_ptr<StreamDecompressor> create(Format format, QIODevice& device);
+
+    // Appends the next piece of decompressed output (up to about maxBytes).
+    // Returns false on a read or format error; atEnd is set once the input is exhausted.
+    virtual bool read(QByteArray& out, int maxBytes, bool& atEnd) = 0;
+
+    // Compressed bytes consumed so far, for progress reporting.
+    virtual qint64 inputPosition() const = 0;
+};
+
+#endif // STREAMDECOMPRESSOR_H
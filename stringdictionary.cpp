@@ -0,0 +1,22 @@
+#include "stringdictionary.h"
+
+quint32 StringDictionary::insert(const QString& value) {
+    auto it = codes.constFind(value);
+    if (it != codes.constEnd()) {
+        return it.value();
+    }
+
+    const quint32 code = static_cast<quint32>(entries.size());
+    entries.append(value);
+    codes.insert(value, code);
+    return code;
+}
+
+quint32 StringDictionary::find(const QString& value) const {
+    return codes.value(value, NotFound);
+}
+
+void StringDictionary::clear() {
+    entries.clear();
+    codes.clear();
+}
@@ -0,0 +1,29 @@
+#ifndef STRINGDICTIONARY_H
+#define STRINGDICTIONARY_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Distinct values of a categorical column. Each value gets a dense code in
+// insertion order, so rows can store and compare codes instead of strings.
+class StringDictionary {
+public:
+    static constexpr quint32 NotFound = 0xffffffffu;
+
+    // Returns the code of value, adding it when it is new.
+    quint32 insert(const QString& value);
+    quint32 find(const QString& value) const;
+
+    const QString& value(quint32 code) const { return entries.at(static_cast<int>(code)); }
+    const QVector<QString>& values() const { return entries; }
+    int size() const { return entries.size(); }
+
+    void clear();
+
+private:
+    QVector<QString> entries;
+    QHash<QString, quint32> codes;
+};
+
+#endif // STRINGDICTIONARY_H
@@ -0,0 +1,111 @@
+#include "textcolumn.h"
+#include "csvparser.h"
+#include "mappedsource.h"
+
+namespace {
+
+const int DecodedCacheEntries = 4096;
+
+// offset: bits 0-39, length: 40-55, escaped: 56, source id: 57-63
+const int LengthShift = 40;
+const int EscapedShift = 56;
+const int SourceShift = 57;
+const quint64 OffsetMask = (quint64(1) << LengthShift) - 1;
+
+quint64 makeHandle(qint64 offset, int length, bool escaped, quint8 source) {
+    return (quint64(offset) & OffsetMask) | (quint64(length) << LengthShift)
+         | (quint64(escaped) << EscapedShift) | (quint64(source) << SourceShift);
+}
+
+}
+
+TextColumn::TextColumn()
+    : decoded(DecodedCacheEntries)
+{
+}
+
+// The cache belongs to one column, so copies start with an empty one
+TextColumn::TextColumn(const TextColumn& other)
+    : handles(other.handles)
+    , arena(other.arena)
+    , sources(other.sources)
+    , decoded(DecodedCacheEntries)
+{
+}
+
+TextColumn& TextColumn::operator=(const TextColumn& other) {
+    handles = other.handles;
+    arena = other.arena;
+    sources = other.sources;
+    decoded.clear();
+    return *this;
+}
+
+void TextColumn::append(const QByteArray& utf8) {
+    const int length = qMin(utf8.size(), MaxLength);
+    handles.append(makeHandle(arena.size(), length, false, 0));
+    arena.append(utf8.constData(), length);
+}
+
+void TextColumn::append(const TextSpan& span) {
+    // Rows hold their source alive; a source that is already gone leaves the row empty
+    if (span.source >= sources.size()) {
+        sources.resize(span.source + 1);
+    }
+    if (!sources.at(span.source)) {
+        sources[span.source] = MappedSource::find(span.source);
+        if (!sources.at(span.source)) {
+            append(QByteArray());
+            return;
+        }
+    }
+    handles.append(makeHandle(span.offset, qMin(span.length, MaxLength), span.escaped, span.source));
+}
+
+QByteArray TextColumn::utf8(int row) const {
+    const quint64 handle = handles.at(row);
+    const qint64 offset = static_cast<qint64>(handle & OffsetMask);
+    const int length = static_cast<int>((handle >> LengthShift) & MaxLength);
+    const quint8 source = static_cast<quint8>(handle >> SourceShift);
+    if (source == 0) {
+        return arena.mid(static_cast<int>(offset), length);
+    }
+
+    const MappedSource* mapped = sources.at(source).get();
+    const char* begin = mapped->data() + offset;
+    return CsvParser::toUtf8(CsvField{begin, begin + length, ((handle >> EscapedShift) & 1) != 0});
+}
+
+bool TextColumn::isMapped() const {
+    for (const std::shared_ptr<MappedSource>& source : sources) {
+        if (source) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextColumn::detach() {
+    if (!isMapped()) {
+        return;
+    }
+    // Decoded strings stay valid: the text is the same, only its home moves
+    for (int row = 0; row < handles.size(); ++row) {
+        if ((handles.at(row) >> SourceShift) != 0) {
+            const QByteArray text = utf8(row);
+            handles[row] = makeHandle(arena.size(), text.size(), false, 0);
+            arena.append(text);
+        }
+    }
+    sources.clear();
+}
+
+QString TextColumn::toString(int row) const {
+    if (const QString* text = decoded.object(row)) {
+        return *text;
+    }
+    QString* text = new QString(QString::fromUtf8(utf8(row)));
+    const QString result = *text;
+    decoded.insert(row, text);
+    return result;
+}
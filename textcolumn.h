@@ -0,0 +1,54 @@
+#ifndef TEXTCOLUMN_H
+#define TEXTCOLUMN_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+class MappedSource;
+
+// Text a parser left in a mapped source file instead of copying it out.
+struct TextSpan {
+    qint64 offset = 0;
+    int length = 0;
+    quint8 source = 0;     // MappedSource id; 0 means the text was copied
+    bool escaped = false;  // still contains doubled quotes
+};
+
+// Per-row text that is either copied into an owned UTF-8 arena or left in a
+// memory-mapped source file and decoded on demand. Both kinds take one
+// 64-bit handle per row; decoded QStrings go through a small LRU cache.
+class TextColumn {
+public:
+    static constexpr int MaxLength = 0xffff;
+
+    TextColumn();
+    TextColumn(const TextColumn& other);
+    TextColumn& operator=(const TextColumn& other);
+
+    int size() const { return handles.size(); }
+    void reserve(int rows) { handles.reserve(rows); }
+    void append(const QByteArray& utf8);
+    void append(const TextSpan& span);
+
+    bool isMapped() const;
+    // Copies text still in mapped sources into the arena and lets the sources
+    // go, so the files can be rewritten without pulling rows out from under them.
+    void detach();
+
+    // Uncached; a copy of the column can be read from another thread.
+    QByteArray utf8(int row) const;
+    // Cached; for the GUI thread.
+    QString toString(int row) const;
+
+private:
+    QVector<quint64> handles;
+    QByteArray arena;
+    QVector<std::shared_ptr<MappedSource>> sources;  // indexed by source id
+    mutable QCache<int, QString> decoded;
+};
+
+#endif // TEXTCOLUMN_H